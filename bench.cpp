@@ -0,0 +1,265 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+/* Micro-benchmarks of the kernels of the training process, each run on its own 
+ * over a synthetic (uniform) Dataset for each combination of the Lattice sizes, 
+ * dimensions and radii supplied: 
+ *  
+ *  diapasom-bench.serial latticedims=10,30,60 dimensions=4,16,64 radii=1,4,16 
+ *      records=4096 repeats=5 dir=. rseed=1 
+ *  
+ * The results are printed by the master rank, one JSON object per line: the kernel, 
+ * the parameters, the time per record (presented by each rank) and the bandwidth, 
+ * i.e., the bytes the kernel has to move over its time (the weights scanned by 
+ * bmu_find() are counted in full, as if no distance was abandoned). Each time is the 
+ * one of the fastest of repeats runs, of the slowest rank. 
+ */
+
+#include "trainfuncs.hpp"
+
+#include <random>
+
+
+using som::TrainSettings; 
+using som::Lattice; 
+using BenchTimer = som::parallel::Timer<std::chrono::nanoseconds>; 
+
+
+/** @brief Splits the comma-separated list of unsigned values */
+static inline 
+std::vector<unsigned> 
+split(const std::string& list) 
+{
+    std::vector<unsigned> values{}; 
+    std::stringstream ss{ list }; 
+    std::string token{}; 
+    while ( std::getline( ss, token, ',' ) ) 
+        if ( token.size() > 0 ) 
+            values.push_back( static_cast<unsigned>( std::stoul( token ) ) ); 
+    return values; 
+}
+
+
+/** @brief Writes (on the master rank) a Dataset of records uniform random records in [0, 1)
+ *  with the given dimensions to dir and returns its name. All ranks must call it 
+ */
+static inline 
+std::string 
+dataset_write(const std::string& dir, unsigned records, unsigned dimensions, unsigned rseed) 
+{
+    const std::string fname{ dir + "/bench" + std::to_string( dimensions ) + ".txt" }; 
+    if ( som::parallel::rank() == 0 ) 
+    {
+        std::ofstream ofile{ fname, std::ios::trunc }; 
+        if ( not ofile.is_open() ) 
+            throw std::runtime_error{ "could not write dataset " + fname }; 
+
+        std::mt19937 engine{ rseed }; 
+        std::uniform_real_distribution<double> uniform{ 0, 1 }; 
+        for (unsigned gidx{ 0 }; gidx < records; ++gidx) 
+            for (unsigned d{ 0 }; d < dimensions; ++d) 
+                ofile << uniform( engine ) << ((d + 1 < dimensions)? " " : "\n"); 
+    }
+    som::parallel::barrier(); // the other ranks wait for the file 
+    return fname; 
+}
+
+
+/** @brief Runs kernel repeats times, returns the time of the fastest run of the slowest rank (nanoseconds). 
+ *  All ranks must call it 
+ */
+template <class Kernel>
+static inline 
+double 
+best_time(unsigned repeats, Kernel kernel) 
+{
+    double best{ std::numeric_limits<double>::infinity() }; 
+    for (unsigned repeat{ 0 }; repeat < repeats; ++repeat) 
+    {
+        BenchTimer timer{}; 
+        timer.start(); 
+        kernel(); 
+        timer.stop(); 
+        best = std::min( best, static_cast<double>( timer.total() ) ); 
+    }
+    return som::parallel::max_all( best ); 
+}
+
+
+/** @brief Prints (on the master rank) the result of a kernel that took nanoseconds 
+ *  for records records moving bytes bytes 
+ */
+static inline 
+void 
+report(const char* kernel, unsigned latticedim, unsigned dimensions, double nradius, 
+       std::size_t records, double bytes, double nanoseconds) 
+{
+    if ( som::parallel::rank() > 0 ) 
+        return; 
+    std::ostringstream line{}; 
+    line << "{\"kernel\":\"" << kernel << "\"" 
+         << ",\"backend\":\"" << som::parallel::backend() << "\"" 
+         << ",\"ranks\":" << som::parallel::ranks() 
+         << ",\"latticedim\":" << latticedim 
+         << ",\"dimensions\":" << dimensions 
+         << ",\"nradius\":" << nradius 
+         << ",\"records\":" << records 
+         << ",\"nsperrecord\":" << nanoseconds /static_cast<double>( std::max( records, std::size_t{ 1 } ) ) 
+         << ",\"gbpersec\":" << ((nanoseconds > 0)? bytes /nanoseconds : 0.0) 
+         << "}"; 
+    myprint::outln( line.str() ); 
+}
+
+
+/** @brief Benchmarks the kernels for the TrainState_ state, N > 0 is the number of dimensions 
+ *  known at compile time (see fixed_size()), as selected by batch_kernels() 
+ */
+template <unsigned N, class P, class D, class M>
+static inline 
+void 
+bench_kernels(som::TrainState_<P, D, M>& state, unsigned latticedim, const std::vector<unsigned>& radii, unsigned repeats) 
+{
+    using T = typename P::value_type; 
+    using A = typename P::accumulator_type; 
+
+    const D& dataset{ state.constants.dataset }; 
+    const unsigned rrecords{ dataset.rrecords() }; 
+    const unsigned dimensions{ dataset.dimensions() }; 
+    const unsigned neurons{ state.weights.size2() }; 
+    const double wbytes{ static_cast<double>( state.weights.size3() *sizeof(T) ) }; 
+    unsigned* bmus{ state.bmus.get() }; 
+
+    volatile T sink{ 0 }; // keeps the distances from being optimized away 
+    double time{ best_time( repeats, [&]() 
+        {
+            T sum{ 0 }; 
+            for (unsigned lidx{ 0 }; lidx < rrecords; ++lidx) 
+            {
+                const typename D::record_type record{ dataset.rrecord( lidx ) }; 
+                for (unsigned index{ 0 }; index < neurons; ++index) 
+                    sum += som::squared_distance<N>( state.weights.entry( index ), record, dimensions ); 
+            }
+            sink = sum; 
+        } 
+    ) }; 
+    report( "squared_distance", latticedim, dimensions, 0, rrecords, wbytes *rrecords, time ); 
+
+    state.metric.prepare( state.weights ); 
+    unsigned brow, bcol; 
+    time = best_time( repeats, [&]() 
+        {
+            for (unsigned lidx{ 0 }; lidx < rrecords; ++lidx) 
+                som::bmu_find<N>( state.metric, state.weights, dataset.rrecord( lidx ), bmus + lidx, &brow, &bcol ); 
+        } 
+    ); 
+    report( "bmu_find", latticedim, dimensions, 0, rrecords, wbytes *rrecords, time ); 
+
+    const unsigned cols{ state.weights.cols() }; 
+    const unsigned rows{ state.weights.rows() }; 
+    for (const unsigned radius : radii) 
+    {
+        state.nradius = radius; 
+
+        // the cells of the neighbourhoods, as clipped by batch_fraction_accumulate() 
+        std::size_t cells{ 0 }; 
+        for (unsigned lidx{ 0 }; lidx < rrecords; ++lidx) 
+        {
+            const unsigned row{ bmus[ lidx ] /cols }, col{ bmus[ lidx ] %cols }; 
+            cells += static_cast<std::size_t>( std::min( row + radius + 1, rows ) - ((radius > row)? 0 : row - radius) ) *
+                ( std::min( col + radius + 1, cols ) - ((radius > col)? 0 : col - radius) ); 
+        }
+
+        time = best_time( repeats, [&]() 
+            {
+                state.bfraction.init(); 
+                for (unsigned lidx{ 0 }; lidx < rrecords; ++lidx) 
+                    som::batch_fraction_accumulate<N>( 
+                        state, dataset.rrecord( lidx ), bmus[ lidx ] /cols, bmus[ lidx ] %cols 
+                    ); 
+            } 
+        ); 
+        report( 
+            "batch_fraction_accumulate", latticedim, dimensions, radius, rrecords, 
+            static_cast<double>( cells ) *dimensions *(sizeof(T) + 2 *sizeof(A)), time 
+        ); 
+    }
+
+    const double nbytes{ static_cast<double>( state.bfraction.numerator.size3() *sizeof(A) ) }; 
+    time = best_time( repeats, [&]() { state.bfraction.reduce(); } ); 
+    report( "BatchFraction::reduce", latticedim, dimensions, 0, rrecords, 2 *nbytes, time ); 
+
+    // the weights move a little at each run, as they would batch after batch 
+    time = best_time( repeats, [&]() { sink = static_cast<T>( som::batch_fraction_commit( state.bfraction, state.weights ) ); } ); 
+    report( "batch_fraction_commit", latticedim, dimensions, 0, rrecords, nbytes + 2 *wbytes, time ); 
+}
+
+
+/** @brief Benchmarks the kernels for a latticedim x latticedim Lattice trained with the Dataset fname */
+static inline 
+void 
+bench(const std::string& fname, unsigned records, unsigned latticedim, const std::vector<unsigned>& radii, unsigned repeats) 
+{
+    TrainSettings settings{ fname }; 
+    settings.rows( latticedim ).cols( latticedim ).batchsize( records ).rseed( 1 ); 
+
+    Lattice lattice{ latticedim }; 
+    som::TrainState_<> state{ lattice, settings }; 
+    som::weights_random_init( state ); 
+
+    switch ( state.constants.dataset.dimensions() ) 
+    {
+        case 2: bench_kernels<2>( state, latticedim, radii, repeats ); break; 
+        case 3: bench_kernels<3>( state, latticedim, radii, repeats ); break; 
+        case 4: bench_kernels<4>( state, latticedim, radii, repeats ); break; 
+        case 8: bench_kernels<8>( state, latticedim, radii, repeats ); break; 
+        case 16: bench_kernels<16>( state, latticedim, radii, repeats ); break; 
+        case 32: bench_kernels<32>( state, latticedim, radii, repeats ); break; 
+        case 64: bench_kernels<64>( state, latticedim, radii, repeats ); break; 
+        default: bench_kernels<0>( state, latticedim, radii, repeats ); break; 
+    }
+}
+
+
+int main(const int argc, const char* argv[]) 
+{
+    parameters::CliArgsParser cliargs{ argc, argv };    
+
+    const std::vector<unsigned> latticedims{ split( cliargs.get<std::string>( "latticedims", "10,30,60" ) ) }; 
+    const std::vector<unsigned> dimensions{ split( cliargs.get<std::string>( "dimensions", "4,16,64" ) ) }; 
+    const std::vector<unsigned> radii{ split( cliargs.get<std::string>( "radii", "1,4,16" ) ) }; 
+    const unsigned records{ cliargs.get<unsigned>( "records", 4096 ) }; 
+    const unsigned repeats{ cliargs.get<unsigned>( "repeats", 5 ) }; 
+    const std::string dir{ cliargs.get<std::string>( "dir", "." ) }; 
+    const unsigned rseed{ cliargs.get<unsigned>( "rseed", 1 ) }; 
+
+    for (const unsigned dims : dimensions) 
+    {
+        const std::string fname{ dataset_write( dir, records, dims, rseed ) }; 
+        for (const unsigned latticedim : latticedims) 
+            bench( fname, records, latticedim, radii, repeats ); 
+
+        som::parallel::barrier(); // all ranks are done with the file 
+        if ( som::parallel::rank() == 0 ) 
+            std::remove( fname.c_str() ); 
+    }
+    return 0; 
+}
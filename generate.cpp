@@ -0,0 +1,65 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+/* Generates a synthetic dataset, drawn from a mixture of Gaussians (see som::GaussianMixture), 
+ * in any of the input formats of the storages: 
+ *  
+ *  diapasom-generate records=1000000 dimensions=16 clusters=8 spread=0.05 density=1 
+ *      format=dense rseed=1 output=dataset.txt 
+ *  
+ * The records are written to stdout if no output is supplied. 
+ */
+
+#include "generator.hpp"
+
+
+int main(const int argc, const char* argv[]) 
+{
+    parameters::CliArgsParser cliargs{ argc, argv };    
+
+    const std::size_t records{ cliargs.get<std::size_t>( "records", 100000 ) }; 
+    const std::string output{ cliargs.get<std::string>( "output", "" ) }; 
+
+    som::GaussianMixture mixture{ 
+        cliargs.get<unsigned>( "dimensions", 16 ), 
+        cliargs.get<unsigned>( "clusters", 8 ), 
+        cliargs.get<double>( "spread", 0.05 ), 
+        cliargs.get<double>( "density", 1 ), 
+        cliargs.get<unsigned>( "rseed", 1 ) 
+    }; 
+    const som::DatasetFormat format{ som::dataset_format( cliargs.get<std::string>( "format", "dense" ) ) }; 
+
+    if ( output.size() == 0 ) 
+    {
+        mixture.write( std::cout, records, format ); 
+        return 0; 
+    }
+
+    std::ofstream ofile{ output, std::ios::trunc }; 
+    if ( not ofile.is_open() ) 
+        throw std::runtime_error{ "could not write dataset " + output }; 
+    mixture.write( ofile, records, format ); 
+    ofile.close(); 
+    if ( not ofile ) 
+        throw std::runtime_error{ "could not write dataset " + output }; 
+    return 0; 
+}
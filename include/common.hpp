@@ -27,6 +27,7 @@
 #include <string>
 #include <iostream>
 #include <sstream>
+#include <iomanip>
 #include <vector>
 #include <cassert>
 #include <cstring>
@@ -34,6 +35,9 @@
 #include <ctime>
 #include <climits>
 #include <chrono>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
 
 #include "myprint.hpp"
 #include "parameters.hpp"
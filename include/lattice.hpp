@@ -55,6 +55,26 @@ class TrainSettings
     double mnradius{ 0 }; 
     double mrdecay{ 1e-1 }; 
     unsigned mrseed{ 0 }; 
+    std::string mprecision{ "double" }; 
+    std::string mstorage{ "dense" }; 
+    std::string mmetric{ "euclidean" }; 
+    std::string mbmusearch{ "scan" }; 
+    unsigned mbmuwindow{ 2 }; 
+    unsigned mbmurescan{ 10 }; 
+    unsigned mbmusketch{ 16 }; 
+    double mbmurecall{ 0.05 }; 
+    std::string mlayout{ "neurons" }; 
+    unsigned malignment{ 64 }; 
+    std::string mhugepages{ "none" }; 
+    std::string mnuma{ "none" }; 
+    std::string mtrace{ "" }; 
+    unsigned mtracesize{ 1 << 16 }; 
+    std::string mcounters{ "none" }; 
+    std::string mfpevent{ "0" }; 
+    std::string mmetrics{ "" }; 
+    std::string mprintformat{ "text" }; 
+    std::string mprintmode{ "sync" }; 
+    unsigned mprintqueue{ 2 }; 
     TrainCallable mepcall{}; 
 
     public: 
@@ -115,6 +135,86 @@ class TrainSettings
         TrainSettings, rseed, unsigned, 
         (seed for the random number generator, if rseed() > 0 the results are replicable)
     )
+    getfsetter(
+        TrainSettings, precision, std::string, 
+        (precision of the training: double (default), single (float storage and accumulators) or mixed (float storage and double accumulators))
+    )
+    getfsetter(
+        TrainSettings, storage, std::string, 
+        (storage of the dataset in memory: dense (default), uint8 and uint16 (quantized with a scale and an offset per dimension while the dataset is read, in two passes, so that only the quantized values are held) sparse (CSR, the dataset is read in svmlight format) or binary (bits, Hamming distance against the weights thresholded at 0.5))
+    )
+    getfsetter(
+        TrainSettings, metric, std::string, 
+        (metric used to find the best matching unit: euclidean (default), cosine (the records are normalized at load time), manhattan or mahalanobis (diagonal covariance estimated from the dataset); dense and quantized storages only, except euclidean)
+    )
+    getfsetter(
+        TrainSettings, bmusearch, std::string, 
+        (how the best matching units are found: scan (default, all the neurons), bounds (exact, skips the scan while triangle-inequality bounds, updated with the drift of the neurons, prove the BMU unchanged; euclidean, manhattan and mahalanobis metrics only) window (approximate, searches only the neurons around the previous BMU, see bmuwindow() and bmurescan(); the rate of BMUs that differ from the exact ones is reported at each epoch), tree (exact, kd-tree over the weights rebuilt at each batch, for low-dimensional datasets and large Lattices; euclidean, manhattan and mahalanobis metrics only) or projection (approximate, for high-dimensional datasets: re-ranks the neurons closest in a random projection, see bmusketch() and bmurecall()); dense and quantized storages only, except scan)
+    )
+    getfsetter(
+        TrainSettings, bmuwindow, unsigned, 
+        (radius (in cells) of the window around the previous BMU searched by bmusearch window)
+    )
+    getfsetter(
+        TrainSettings, bmurescan, unsigned, 
+        (with bmusearch window all the neurons are searched every bmurescan() epochs (and always in the first one, 0 for the first one only))
+    )
+    getfsetter(
+        TrainSettings, bmusketch, unsigned, 
+        (dimensions of the random projection used by bmusearch projection)
+    )
+    getfsetter(
+        TrainSettings, bmurecall, double, 
+        (fraction of the neurons, the closest in the random projection, re-ranked with the exact distances by bmusearch projection: larger values trade speed for accuracy)
+    )
+    getfsetter(
+        TrainSettings, layout, std::string, 
+        (layout of the weights searched for the best matching units: neurons (default, the values of each neuron are contiguous) or interleaved8 and interleaved16 (blocks of 8 and 16 neurons with the values of each dimension contiguous, so that the distances from a block are computed together; bmusearch scan with euclidean, manhattan and mahalanobis metrics only))
+    )
+    getfsetter(
+        TrainSettings, alignment, unsigned, 
+        (alignment in bytes (a power of 2) of the memory allocated for the training)
+    )
+    getfsetter(
+        TrainSettings, hugepages, std::string, 
+        (huge pages for the memory allocated for the training: none (default) or advise (madvise(MADV_HUGEPAGE) on the blocks of at least 2 MiB, aligned accordingly))
+    )
+    getfsetter(
+        TrainSettings, numa, std::string, 
+        (NUMA placement of the memory allocated for the training: none (default), firsttouch (touched by the allocating rank) or local (mbind(MPOL_LOCAL) moving the pages already touched, then touched))
+    )
+    getfsetter(
+        TrainSettings, trace, std::string, 
+        (file where the spans of the training (see myprint::Tracer) of all ranks are written in Chrome trace format (one track per rank) at the end of the training, empty (default) for no tracing)
+    )
+    getfsetter(
+        TrainSettings, tracesize, unsigned, 
+        (spans kept by each rank when tracing (see trace()), the oldest ones are overwritten)
+    )
+    getfsetter(
+        TrainSettings, counters, std::string, 
+        (hardware performance counters read around each phase of the training and reported by each rank: none (default) or hardware (cycles, instructions and last level cache misses with perf_event_open, Linux only))
+    )
+    getfsetter(
+        TrainSettings, fpevent, std::string, 
+        (raw (model specific) perf event counting the floating point operations with counters hardware (e.g., 0x1fc7), 0 (default) not to count them)
+    )
+    getfsetter(
+        TrainSettings, metrics, std::string, 
+        (file where the master rank appends, as the training goes, one JSON object per line for each epoch (epoch, diff, nradius, time of each phase in microseconds, bytes communicated and records per second, all measured on the master rank), empty (default) for none)
+    )
+    getfsetter(
+        TrainSettings, printformat, std::string, 
+        (format of the Lattice printed by Lattice::print(): text (default, latticeEPOCH.out, one neuron per line: row, column and values) or binary (latticeEPOCH.bin, a 32 bytes header, see WeightsHeader, followed by the raw weights))
+    )
+    getfsetter(
+        TrainSettings, printmode, std::string, 
+        (how Lattice::print() writes the Lattice: sync (default, formatted and written before returning) or async (copied and written by a background thread of the master rank while the training goes on, all written before Lattice::train() returns, see printqueue()))
+    )
+    getfsetter(
+        TrainSettings, printqueue, unsigned, 
+        (copies of the Lattice in flight (being written or waiting to be) with printmode async: Lattice::print() waits when all are, bounding the memory used (2 by default, double buffering))
+    )
     getfsetter(
         TrainSettings, epcall, TrainCallable, 
         (callable than will be called at each epoch)
@@ -162,7 +262,9 @@ class Lattice
     unsigned ranks() const noexcept { return som::parallel::ranks(); }
 
 
-    /** @brief Prints the state of the Lattice to fname (if provided) or to stdout */
+    /** @brief Prints the state of the Lattice to fname (if provided) or to latticeEPOCH.out 
+     *  (latticeEPOCH.bin with TrainSettings::printformat() binary) 
+     */
     void print(const std::string& fname="") const;
 
 
@@ -172,6 +274,22 @@ class Lattice
     
     /** @brief Returns the current epoch of the training process */ 
     unsigned epoch() const noexcept; 
+
+    private: 
+    /** @brief Trains the Lattice with the Precision P, selecting the storage of the Dataset */
+    template <class P>
+    Lattice& 
+    train_(const TrainSettings& settings); 
+
+    /** @brief Trains the Lattice with the Precision P and the Dataset storage D, selecting the metric */
+    template <class P, class D>
+    Lattice& 
+    train_(const TrainSettings& settings); 
+
+    /** @brief Trains the Lattice with the Precision P, the Dataset storage D and the metric M */
+    template <class P, class D, class M>
+    Lattice& 
+    train_(const TrainSettings& settings); 
 }; 
 } // namespace som 
 #undef self
@@ -25,6 +25,16 @@
 
 #include "myprint.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#ifdef __linux__ 
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 
 #define self (*this)
 
@@ -35,86 +45,483 @@ namespace som
 using namespace myprint; 
 
 
-/** @brief Alias for a function that allocates memory */
-template <class T>
-using Malloc = T*(*)(unsigned); 
-/** @brief Alias for a function that frees memory */
-template <class T>
-using Free = void(*)(T*); 
+/** @brief The NUMA placement policies of som::Allocation */
+enum class Numa 
+{
+    none,       // wherever the operating system decides 
+    firsttouch, // the memory is touched (zeroed) right after the allocation by the allocating rank 
+    local       // mbind(MPOL_LOCAL, MPOL_MF_MOVE): the node of the CPU that first touches each page 
+}; 
 
+/** @brief Simple class representing the policy used to allocate the memory of 
+ *  som::Memory<T> and som::parallel::Memory<T> (see som::allocation()) 
+ */
+struct Allocation 
+{
+    std::size_t alignment{ 64 }; // bytes, a power of 2 (at least sizeof(void*)) 
+    bool hugepages{ false };     // madvise(MADV_HUGEPAGE) on the blocks of at least hugepage bytes 
+    Numa numa{ Numa::none }; 
 
-/** @brief Allocates contiguous memory with std::malloc for count objects of type T */
-template <class T>
-inline 
-T* 
-malloc(unsigned count) 
-{ 
-    Context context{ 
-        "allocating", count *sizeof(T),
-        "bytes with std::malloc" 
-    }; 
-    T* ptr = static_cast<T*>(
-        std::malloc( count *sizeof(T) )
-    );  
-    assert( ptr != nullptr ); 
-    context.results( "address", ptr ); 
-    return ptr; 
-}
-/** @brief Frees contiguous memory with std::free for count objects of type T */
-template <class T>
+    static constexpr std::size_t hugepage{ 2 << 20 }; 
+
+    /** @brief The alignment of a block of bytes: hugepage if huge pages are requested 
+     *  and the block is large enough, alignment otherwise 
+     */
+    std::size_t align(std::size_t bytes) const noexcept 
+    { return (self.hugepages and bytes >= hugepage)? hugepage : std::max( self.alignment, sizeof(void*) ); }
+
+    /** @brief Applies the huge pages and NUMA policies to the block of bytes at ptr, 
+     *  right after its allocation (on Linux, elsewhere only first touch is applied) 
+     */
+    void place(void* ptr, std::size_t bytes) const noexcept 
+    {
+#ifdef __linux__ 
+        const std::size_t page{ static_cast<std::size_t>( sysconf(_SC_PAGESIZE) ) }; 
+        // only the whole pages inside the block 
+        const std::uintptr_t first{ (reinterpret_cast<std::uintptr_t>(ptr) + page - 1) /page *page }; 
+        const std::uintptr_t last{ (reinterpret_cast<std::uintptr_t>(ptr) + bytes) /page *page }; 
+        if ( last > first ) 
+        {
+            if ( self.hugepages and bytes >= hugepage ) 
+                madvise( reinterpret_cast<void*>(first), last - first, MADV_HUGEPAGE ); 
+            // the pages of a recycled block may have been touched already, they are moved 
+            if ( self.numa == Numa::local ) 
+                syscall( SYS_mbind, first, last - first, 4 /* MPOL_LOCAL */, nullptr, 0, 2 /* MPOL_MF_MOVE */ ); 
+        }
+#endif
+        if ( self.numa != Numa::none ) 
+            std::memset( ptr, 0, bytes ); 
+    }
+}; // struct Allocation 
+
+/** @brief The Allocation policy in use, it can be modified at any time, 
+ *  the memory already allocated is not affected 
+ */
 inline 
-void 
-free(T* ptr) 
+Allocation& 
+allocation() noexcept 
 { 
-    assert( ptr != nullptr ); 
-    Context context{ 
-        "freeing", ptr,
-        "with std::free" 
-    }; 
-    std::free( ptr ); 
+    static Allocation policy{}; 
+    return policy; 
 }
 
+/** @brief Simple class that sets the Allocation policy in use while it is alive */
+class AllocationScope 
+{
+    Allocation mprevious; 
+
+    public: 
+    AllocationScope(const Allocation& policy) noexcept 
+        : mprevious{ som::allocation() } 
+    { som::allocation() = policy; }
+
+    ~AllocationScope() noexcept 
+    { som::allocation() = self.mprevious; }
+
+    AllocationScope(const AllocationScope&) = delete; 
+    AllocationScope& operator = (const AllocationScope&) = delete; 
+}; // class AllocationScope
 
-/** @brief Simple class representing the global state of the allocated memory. 
- *  Used internally by som::Memory<T>.
+
+/** @brief The categories of the memory accounted by som::State (see MemoryScope) */
+enum class MemoryCategory : unsigned 
+{
+    other,      // anything not in the categories below 
+    dataset,    // the records (and the buffers used to read them) 
+    weights,    // the weights of the Lattice (in any layout) 
+    bfraction,  // the batch fraction 
+    scratch,    // the per-record and per-neuron buffers of the BMU searches 
+    snapshots,  // the copies of the weights written in the background (see SnapshotWriter) 
+    count 
+}; 
+
+
+/** @brief Simple class representing the global state of the allocated memory: 
+ *  the active blocks and the bytes of each MemoryCategory, private and symmetric 
+ *  (i.e., som::parallel::Memory<T>) apart, and the footprint (the bytes reserved 
+ *  by the Arena objects, padding included, plus the ones of the blocks allocated 
+ *  outside of them), with their high-water marks (see reset_peaks()). 
+ *  Used internally by som::Memory<T> and som::Arena, see som::memory() 
  */
 class State 
 {   
-    unsigned mblocks{ 0 }; 
-    unsigned mbytes{ 0 }; 
+    static constexpr unsigned categories{ static_cast<unsigned>( MemoryCategory::count ) }; 
+
+    std::size_t mblocks{ 0 }; 
+    std::size_t mbytes{ 0 }; 
+    std::size_t mreserved{ 0 };  // bytes reserved by the Arena objects 
+    std::size_t mfootprint{ 0 }; // mreserved plus the bytes of the blocks not handed out by them 
+    std::size_t mpeak{ 0 }; 
+    std::size_t mcbytes[ categories ][ 2 ]{}; // for each category, private and symmetric 
+    std::size_t mcpeaks[ categories ][ 2 ]{}; 
+    MemoryCategory mcategory{ MemoryCategory::other }; 
 
     public: 
+    /** @brief Returns the name of category */
+    static const char* name(MemoryCategory category) noexcept 
+    {
+        constexpr const char* names[ categories ]{ 
+            "other", "dataset", "weights", "bfraction", "scratch", "snapshots" 
+        }; 
+        return names[ static_cast<unsigned>(category) ]; 
+    }
+
     /** @brief Returns the total number of active memory blocks */
-    unsigned blocks() const noexcept 
+    std::size_t blocks() const noexcept 
     { return self.mblocks; }
 
     /** @brief Returns the total number of allocated bytes */
-    unsigned bytes() const noexcept 
+    std::size_t bytes() const noexcept 
     { return self.mbytes; }
 
+    /** @brief Returns the bytes reserved by the Arena objects */
+    std::size_t reserved() const noexcept 
+    { return self.mreserved; }
+
+    /** @brief Returns the bytes actually taken: the ones reserved() plus the ones 
+     *  of the blocks allocated outside of the Arena objects 
+     */
+    std::size_t footprint() const noexcept 
+    { return self.mfootprint; }
+
+    /** @brief Returns the largest footprint() since the last reset_peaks() */
+    std::size_t peak() const noexcept 
+    { return self.mpeak; }
+
+    /** @brief Returns the bytes allocated in category, symmetric or private */
+    std::size_t bytes(MemoryCategory category, bool symmetric) const noexcept 
+    { return self.mcbytes[ static_cast<unsigned>(category) ][ symmetric ]; }
+
+    /** @brief Returns the largest bytes(category, symmetric) since the last reset_peaks() */
+    std::size_t peak(MemoryCategory category, bool symmetric) const noexcept 
+    { return self.mcpeaks[ static_cast<unsigned>(category) ][ symmetric ]; }
+
+    /** @brief Returns the category of the blocks allocated from now on (see MemoryScope) */
+    MemoryCategory category() const noexcept 
+    { return self.mcategory; }
+
+    /** @brief Sets the category of the blocks allocated from now on (see MemoryScope) */
+    void category(MemoryCategory category) noexcept 
+    { self.mcategory = category; }
+
+    /** @brief Restarts the high-water marks from the current footprint() and bytes(category, symmetric) */
+    void 
+    reset_peaks() noexcept 
+    {
+        self.mpeak = self.mfootprint; 
+        std::copy( &self.mcbytes[ 0 ][ 0 ], &self.mcbytes[ 0 ][ 0 ] + 2 *categories, &self.mcpeaks[ 0 ][ 0 ] ); 
+    }
+
+    /** @brief Increments self.reserved() and self.footprint() by bytes (see Arena::reserve()) */
+    void 
+    reserve(std::size_t bytes) noexcept 
+    {
+        self.mreserved += bytes; 
+        self.mfootprint += bytes; 
+        self.mpeak = std::max( self.mpeak, self.mfootprint ); 
+    }
+    /** @brief Decrements self.reserved() and self.footprint() by bytes (see Arena::clear()) */
+    void 
+    release(std::size_t bytes) noexcept 
+    {
+        self.mreserved -= bytes; 
+        self.mfootprint -= bytes; 
+    }
+
     /** @brief Increments the total number of active memory blocks and 
-     *  self.bytes() by bytes 
+     *  self.bytes() (and the ones of category, symmetric or private) by bytes, 
+     *  and self.footprint() too unless the block was handed out by an Arena (reserved) 
      */
     void 
-    inc(unsigned bytes) noexcept 
+    inc(std::size_t bytes, MemoryCategory category, bool symmetric, bool reserved=false) noexcept 
     { 
         self.mblocks++; 
         self.mbytes += bytes; 
+        if ( not reserved ) 
+            self.mfootprint += bytes; 
+        self.mpeak = std::max( self.mpeak, self.mfootprint ); 
+
+        std::size_t& cbytes{ self.mcbytes[ static_cast<unsigned>(category) ][ symmetric ] }; 
+        std::size_t& cpeak{ self.mcpeaks[ static_cast<unsigned>(category) ][ symmetric ] }; 
+        cbytes += bytes; 
+        cpeak = std::max( cpeak, cbytes ); 
     }
     /** @brief Decrements the total number of active memory blocks and 
-     *  self.bytes() by bytes 
+     *  self.bytes() (and the ones of category, symmetric or private) by bytes, 
+     *  and self.footprint() too unless the block was handed out by an Arena (reserved) 
      */
     void 
-    dec(unsigned bytes) noexcept 
+    dec(std::size_t bytes, MemoryCategory category, bool symmetric, bool reserved=false) noexcept 
     { 
         self.mblocks--; 
         self.mbytes -= bytes; 
+        if ( not reserved ) 
+            self.mfootprint -= bytes; 
+        self.mcbytes[ static_cast<unsigned>(category) ][ symmetric ] -= bytes; 
 
         if ( self.blocks() == 0 ) 
             assert( self.bytes() == 0 ); 
     }
 }; // class State  
 
+/** @brief The State of the memory allocated by som::Memory<T> and som::parallel::Memory<T> 
+ *  (of any T) by the current rank 
+ */
+inline 
+State& 
+memory() noexcept 
+{ 
+    static State state{}; 
+    return state; 
+}
+
+/** @brief Simple class representing an arena: a single block of memory, reserved up front, 
+ *  from which smaller blocks are handed out without system calls.
+ *  The blocks are carved one after the other and their space is recycled
+ *  only once all of them have been returned (see deallocate()).
+ *  The bytes reserved are accounted in som::memory() as footprint. 
+ *  Used by som::malloc<T> (see som::arena()) and som::parallel::malloc<T>
+ */
+class Arena
+{
+    public:
+    /** @brief Alias for a function that allocates bytes aligned to alignment */
+    using Acquire = void*(*)(std::size_t bytes, std::size_t alignment); 
+    /** @brief Alias for a function that frees memory allocated by Acquire */
+    using Release = void(*)(void*); 
+
+    private:
+    Acquire macquire{ nullptr }; 
+    Release mrelease{ nullptr }; 
+    char* mbase{ nullptr }; 
+    std::size_t mcapacity{ 0 }; 
+    std::size_t mtop{ 0 };   // bytes already handed out (including the padding)
+    std::size_t mlive{ 0 };  // blocks handed out and not returned yet
+    std::size_t mmisses{ 0 }; // requests that did not fit
+    Arena* mnext{ nullptr };  // the Arena constructed before this one (see reserved())
+    static inline Arena* mlast{ nullptr }; 
+
+    public:
+    Arena(Acquire acquire, Release release) noexcept
+        : macquire{ acquire }, 
+        mrelease{ release }, 
+        mnext{ mlast }
+    { mlast = &self; }
+
+    ~Arena() noexcept
+    { 
+        self.clear(); 
+        Arena** link{ &mlast }; 
+        while ( *link != &self ) 
+            link = &(*link)->mnext; 
+        *link = self.mnext; 
+    }
+
+    Arena(const Arena&) = delete; 
+    Arena& operator = (const Arena&) = delete; 
+
+    /** @brief Returns the bytes reserved */
+    std::size_t capacity() const noexcept { return self.mcapacity; }
+    /** @brief Returns the bytes handed out, including the padding */
+    std::size_t used() const noexcept { return self.mtop; }
+    /** @brief Returns the requests that did not fit since the last reserve() */
+    std::size_t misses() const noexcept { return self.mmisses; }
+
+    /** @brief An upper bound on the bytes taken in an arena by a block of bytes, 
+     *  aligned according to som::allocation(), whatever the blocks handed out before it 
+     */
+    static std::size_t footprint(std::size_t bytes) noexcept 
+    { 
+        const Allocation& policy{ som::allocation() }; 
+        return round( bytes, policy.align( bytes ) ) + policy.align( bytes ) - policy.align( 0 ); 
+    }
+
+    /** @brief Reserves a block of bytes (releasing the previous one, 
+     *  no block must be handed out), placed according to som::allocation(). 
+     *  Throws std::bad_alloc if it cannot, leaving nothing reserved 
+     */
+    void 
+    reserve(std::size_t bytes) 
+    {
+        self.clear(); 
+        if ( bytes == 0 )
+            return; 
+
+        const Allocation& policy{ som::allocation() }; 
+        Context context{
+            "reserving", bytes, 
+            "bytes aligned to", policy.align( bytes )
+        }; 
+        self.mbase = static_cast<char*>( self.macquire( bytes, policy.align( bytes ) ) ); 
+        if ( self.mbase == nullptr ) 
+            throw std::bad_alloc{}; 
+        policy.place( self.mbase, bytes ); 
+        self.mcapacity = bytes; 
+        som::memory().reserve( self.capacity() ); 
+        context.results( "address", static_cast<void*>(self.mbase) ); 
+    }
+
+    /** @brief Releases the reserved block, no block must be handed out */
+    void 
+    clear() noexcept 
+    {
+        assert( self.mlive == 0 ); 
+        if ( self.mbase != nullptr )
+        {
+            Context context{
+                "releasing", self.capacity(), 
+                "bytes at", static_cast<void*>(self.mbase), 
+                "with", self.misses(), "misses"
+            }; 
+            self.mrelease( self.mbase ); 
+            som::memory().release( self.capacity() ); 
+        }
+        self.mbase = nullptr; 
+        self.mcapacity = self.mtop = self.mmisses = 0; 
+    }
+
+    /** @brief Hands out a block of bytes aligned to alignment (a power of 2), 
+     *  nullptr if nothing is reserved or the block does not fit
+     */
+    void* 
+    allocate(std::size_t bytes, std::size_t alignment) noexcept
+    {
+        if ( self.mbase == nullptr )
+            return nullptr; 
+
+        const std::uintptr_t base{ reinterpret_cast<std::uintptr_t>(self.mbase) }; 
+        const std::size_t first{ round( base + self.mtop, alignment ) - base }; 
+        if ( first + bytes > self.capacity() )
+        {
+            self.mmisses++; 
+            return nullptr; 
+        }
+        self.mtop = first + bytes; 
+        self.mlive++; 
+        return self.mbase + first; 
+    }
+
+    /** @brief Whether ptr was handed out by the arena */
+    bool 
+    owns(const void* ptr) const noexcept
+    {
+        return self.mbase != nullptr and
+            static_cast<const char*>(ptr) >= self.mbase and
+            static_cast<const char*>(ptr) < self.mbase + self.capacity(); 
+    }
+
+    /** @brief Whether ptr was handed out by any Arena (alive) */
+    static bool 
+    reserved(const void* ptr) noexcept 
+    {
+        for (const Arena* arena{ mlast }; arena != nullptr; arena = arena->mnext) 
+            if ( arena->owns( ptr ) ) 
+                return true; 
+        return false; 
+    }
+
+    /** @brief Returns the block at ptr to the arena */
+    void 
+    deallocate([[maybe_unused]] void* ptr) noexcept
+    {
+        assert( self.owns( ptr ) ); 
+        assert( self.mlive > 0 ); 
+        if ( --self.mlive == 0 )
+            self.mtop = 0; 
+    }
+
+    private: 
+    static std::size_t round(std::size_t bytes, std::size_t alignment) noexcept 
+    { return (bytes + alignment - 1) /alignment *alignment; }
+}; // class Arena
+
+/** @brief The Arena used by som::malloc<T>, nothing is reserved by default
+ *  (the training process reserves it for its buffers, see TrainState)
+ */
+inline 
+Arena& 
+arena() noexcept 
+{
+    static Arena arena{
+        [](std::size_t bytes, std::size_t alignment) -> void*
+        {
+            void* ptr{ nullptr }; 
+            return (posix_memalign( &ptr, alignment, bytes ) == 0)? ptr : nullptr; 
+        }, 
+        std::free
+    }; 
+    return arena; 
+}
+
+
+/** @brief Alias for a function that allocates memory */
+template <class T>
+using Malloc = T*(*)(std::size_t); 
+/** @brief Alias for a function that frees memory */
+template <class T>
+using Free = void(*)(T*); 
+
+
+/** @brief Allocates contiguous memory for count objects of type T from som::arena() 
+ *  or, if it does not fit, with posix_memalign, according to som::allocation() 
+ */
+template <class T>
+inline 
+T* 
+malloc(std::size_t count) 
+{ 
+    const Allocation& policy{ som::allocation() }; 
+    const std::size_t bytes{ count *sizeof(T) }; 
+    if ( void* ptr = som::arena().allocate( bytes, policy.align( bytes ) ) ) 
+        return static_cast<T*>( ptr ); 
+    Context context{ 
+        "allocating", bytes,
+        "bytes with posix_memalign aligned to", policy.align( bytes ) 
+    }; 
+    void* ptr{ nullptr }; 
+    if ( posix_memalign( &ptr, policy.align( bytes ), bytes ) != 0 ) 
+        ptr = nullptr; 
+    assert( ptr != nullptr ); 
+    policy.place( ptr, bytes ); 
+    context.results( "address", ptr ); 
+    return static_cast<T*>( ptr ); 
+}
+/** @brief Frees contiguous memory for count objects of type T, 
+ *  returning it to som::arena() or with std::free 
+ */
+template <class T>
+inline 
+void 
+free(T* ptr) 
+{ 
+    assert( ptr != nullptr ); 
+    if ( som::arena().owns( ptr ) ) 
+        return som::arena().deallocate( ptr ); 
+    Context context{ 
+        "freeing", ptr,
+        "with std::free" 
+    }; 
+    std::free( ptr ); 
+}
+
+
+/** @brief Simple class that sets the category of the memory allocated while it is alive */
+class MemoryScope 
+{
+    MemoryCategory mprevious; 
+
+    public: 
+    MemoryScope(MemoryCategory category) noexcept 
+        : mprevious{ som::memory().category() } 
+    { som::memory().category( category ); }
+
+    ~MemoryScope() noexcept 
+    { som::memory().category( self.mprevious ); }
+
+    MemoryScope(const MemoryScope&) = delete; 
+    MemoryScope& operator = (const MemoryScope&) = delete; 
+}; // class MemoryScope
+
 
 /** @brief Simple class representing a block of contiguous memory that 
  *  holds size() objects of type T
@@ -122,27 +529,34 @@ class State
 template <class T> 
 class Memory 
 {
-    inline static State state{}; // C++17 feature  
-
-    unsigned msize{ 0 };
+    std::size_t msize{ 0 };
     Free<T> mfree{ nullptr }; 
     T* data{ nullptr }; 
+    MemoryCategory mcategory{ MemoryCategory::other }; // accounted in som::memory() 
+    bool msymmetric{ false }; 
+    bool mreserved{ false }; // handed out by an Arena, accounted in its footprint 
 
 
     public:
+    /** @brief The type of the objects held */
+    using value_type = T; 
+
     /** @brief Constructs a Memory object in disengaged state */
     Memory() : Memory{ 0 } {}
     /** @brief Constructs a Memory object to hold count elements of type T 
      *  using the som::malloc<T> and som::free<T> functions
      */
-    Memory(unsigned count) : Memory( count, nullptr, nullptr ) {}
+    Memory(std::size_t count) : Memory( count, nullptr, nullptr ) {}
     /** @brief Constructs a Memory object to hold count elements of type T 
-     *  using the provided functions Malloc<T> and Free<T>
+     *  using the provided functions Malloc<T> and Free<T>, accounted in 
+     *  the current category of som::memory() as symmetric memory if symmetric is true 
      */
-    Memory(unsigned count, Malloc<T> malloc, Free<T> free)
+    Memory(std::size_t count, Malloc<T> malloc, Free<T> free, bool symmetric=false)
         : 
         msize{ count }, 
-        mfree( free )
+        mfree( free ), 
+        mcategory{ som::memory().category() }, 
+        msymmetric{ symmetric }
     {
         if ( self.size() > 0 )
         {
@@ -161,14 +575,15 @@ class Memory
             self.mfree = free; 
             self.data = malloc( self.size() ); 
             assert( self.get() != nullptr ); 
+            self.mreserved = Arena::reserved( self.get() ); 
             
-            self.state.inc( self.bytes() );
+            som::memory().inc( self.bytes(), self.mcategory, self.msymmetric, self.mreserved );
 
             context.results(
                 self.get(), 
                 "total blocks and bytes", 
-                self.state.blocks(),
-                self.state.bytes() 
+                som::memory().blocks(),
+                som::memory().bytes() 
             ); 
         }
     }
@@ -184,6 +599,9 @@ class Memory
     {
         self.msize = rhs.size();
         self.mfree = rhs.mfree; 
+        self.mcategory = rhs.mcategory; 
+        self.msymmetric = rhs.msymmetric; 
+        self.mreserved = rhs.mreserved; 
         self.data = rhs.data; 
 
         rhs.disengage(); 
@@ -203,11 +621,12 @@ class Memory
         assert( self.size() == rhs.size() ); 
         assert( self.mfree == rhs.mfree ); 
         std::swap( self.data, rhs.data );
+        std::swap( self.mreserved, rhs.mreserved ); 
     }
 
 
-    unsigned size() const noexcept { return self.msize; }
-    unsigned bytes() const noexcept { return self.size() *sizeof(T); }
+    std::size_t size() const noexcept { return self.msize; }
+    std::size_t bytes() const noexcept { return self.size() *sizeof(T); }
 
     /** @brief Get access to the memory */
     T* get() noexcept { return self.data; }
@@ -237,12 +656,12 @@ class Memory
             }; 
 
             self.mfree( self.get() );  
-            self.state.dec( self.bytes() ); 
+            som::memory().dec( self.bytes(), self.mcategory, self.msymmetric, self.mreserved ); 
 
             context.results( 
                 "total blocks and bytes", 
-                self.state.blocks(),
-                self.state.bytes() 
+                som::memory().blocks(),
+                som::memory().bytes() 
             ); 
         }
         self.disengage(); 
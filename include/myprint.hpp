@@ -26,6 +26,11 @@
 #include <iostream>
 #include <fstream>
 #include <cassert>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+#include <type_traits>
+#include <vector>
 
 
 #define self (*this)
@@ -232,6 +237,132 @@ debug(const Args& ... args)
 #endif // not NDEBUG
 
 
+/** @brief Simple class representing a span recorded by the Tracer: 
+ *  its name, start and duration (nanoseconds since the Tracer was enabled) 
+ */
+struct TraceEvent 
+{
+    const char* name{ nullptr }; 
+    std::uint64_t start{ 0 }; 
+    std::uint64_t duration{ 0 }; 
+}; // struct TraceEvent
+
+
+/** @brief Simple class representing a tracer: when enabled, every Context (in debug and 
+ *  release builds alike) records its span in a ring buffer preallocated by enable(), 
+ *  named after the first argument of the Context if it is a string 
+ *  (it must have static storage, e.g., a literal or __func__). 
+ *  Once the buffer is full the oldest spans are overwritten 
+ */
+class Tracer 
+{
+    std::vector<TraceEvent> mevents{}; 
+    std::size_t mrecorded{ 0 }; 
+    std::uint64_t morigin{ 0 }; 
+    bool menabled{ false }; 
+
+    public: 
+    /** @brief Returns the nanoseconds since the epoch of the steady clock */
+    static std::uint64_t now() noexcept 
+    { 
+        return std::chrono::duration_cast<std::chrono::nanoseconds>( 
+            std::chrono::steady_clock::now().time_since_epoch() 
+        ).count(); 
+    }
+
+    /** @brief Whether the spans are being recorded */
+    bool enabled() const noexcept { return self.menabled; }
+
+    /** @brief Starts recording (discarding the spans already recorded) in a buffer of capacity spans */
+    void enable(std::size_t capacity) 
+    {
+        self.mevents.assign( capacity, TraceEvent{} ); 
+        self.mrecorded = 0; 
+        self.morigin = Tracer::now(); 
+        self.menabled = capacity > 0; 
+    }
+
+    /** @brief Stops recording, the spans recorded are kept */
+    void disable() noexcept { self.menabled = false; }
+
+    /** @brief Records the span name started at begin (see now()) and ending now */
+    void record(const char* name, std::uint64_t begin) noexcept 
+    {
+        TraceEvent& event{ self.mevents[ self.mrecorded % self.mevents.size() ] }; 
+        event.name = name; 
+        event.start = begin - self.morigin; 
+        event.duration = Tracer::now() - begin; 
+        self.mrecorded++; 
+    }
+
+    /** @brief Returns the number of spans kept */
+    std::size_t size() const noexcept 
+    { return std::min( self.mrecorded, self.mevents.size() ); }
+
+    /** @brief Returns the number of spans overwritten */
+    std::size_t dropped() const noexcept 
+    { return self.mrecorded - self.size(); }
+
+    /** @brief Calls f(event) for each span kept, from the oldest */
+    template <class F>
+    void for_each(F f) const 
+    {
+        for (std::size_t idx{ self.mrecorded - self.size() }; idx < self.mrecorded; ++idx) 
+            f( self.mevents[ idx % self.mevents.size() ] ); 
+    }
+
+    /** @brief Returns the name of the span of a Context constructed with args */
+    template <class A1, class ... A2toN>
+    static const char* name(const A1& a1, const A2toN& ...) noexcept 
+    {
+        if constexpr ( std::is_convertible<const A1&, const char*>::value ) 
+            return a1; 
+        else 
+            return nullptr; 
+    }
+    static const char* name() noexcept { return nullptr; }
+}; // class Tracer
+
+/** @brief The Tracer used by all Context objects, disabled by default */
+inline 
+Tracer& 
+tracer() noexcept 
+{
+    static Tracer tracer{}; 
+    return tracer; 
+}
+
+
+/** @brief Simple class representing a span traced by tracer(), if enabled, 
+ *  common to Context_ and DummyContext_ 
+ */
+class TracedSpan_ 
+{
+    const char* mname{ nullptr }; 
+    std::uint64_t mbegin{ 0 }; 
+
+    public: 
+    template <class ... Args>
+    TracedSpan_(const Args& ... args) noexcept 
+    {
+        if ( tracer().enabled() ) 
+        {
+            self.mname = Tracer::name( args ... ); 
+            self.mbegin = Tracer::now(); 
+        }
+    }
+
+    ~TracedSpan_() noexcept 
+    {
+        if ( self.mname != nullptr and tracer().enabled() ) 
+            tracer().record( self.mname, self.mbegin ); 
+    }
+
+    TracedSpan_(const TracedSpan_&) = delete; 
+    TracedSpan_& operator = (const TracedSpan_&) = delete; 
+}; // class TracedSpan_
+
+
 /** @brief Simple class representing a context: 
  *  an arbitrary message is show by the constructor and 
  *  the same message (with addition via results()) is show 
@@ -241,6 +372,7 @@ class Context_
 {
     inline static unsigned slevel{ 0 }; // C++17 feature 
 
+    TracedSpan_ span; 
     std::vector<std::string> mfields{}; 
     std::vector<std::string> mresults{}; 
     DebugPrinter printer{};
@@ -253,6 +385,7 @@ class Context_
      */
     template <class ... Args>
     Context_(const Args& ... args) 
+        : span{ args ... } 
     {   
         self.level = Context_::slevel++;
 
@@ -365,9 +498,13 @@ class Context_
  */
 class DummyContext_
 {
+    TracedSpan_ span; 
+
     public: 
     template <class ... Args>
-    DummyContext_(const Args& ...) {}
+    DummyContext_(const Args& ... args) 
+        : span{ args ... } 
+    {}
     
     template <class ... Args>
     DummyContext_&
@@ -23,6 +23,9 @@
 #define SOM_PARALLEL_H_GUARD 
 
 
+#include <stddef.h>
+
+
 void 
 parallel_initialize(unsigned* rank, unsigned* ranks); 
 
@@ -34,20 +37,29 @@ parallel_backend();
 
 
 void* 
-parallel_malloc(unsigned bytes); 
+parallel_malloc(size_t bytes, size_t alignment); 
 
 void 
 parallel_free(void* ptr); 
 
 
 void 
-parallel_broadcast(void* ptr, unsigned bytes, unsigned root); 
+parallel_barrier(); 
+
+void 
+parallel_broadcast(void* ptr, size_t bytes, unsigned root); 
+
+void 
+parallel_sum_all_double(const double* local, double* global, size_t count); 
+
+void 
+parallel_max_all_double(const double* local, double* global, size_t count); 
 
 void 
-parallel_sum_all_double(const double* local, double* global, unsigned count); 
+parallel_sum_all_float(const float* local, float* global, size_t count); 
 
 void 
-parallel_max_all_double(const double* local, double* global, unsigned count); 
+parallel_max_all_float(const float* local, float* global, size_t count); 
 
 
 #endif // SOM_PARALLEL_H_GUARD 
@@ -87,9 +87,16 @@ class State
     unsigned mrank{ 0 };
     unsigned mranks{ 0 }; 
     Timer<std::chrono::microseconds> mtimer{}; // time spent in communication  
+    u64 mcommunicated{ 0 }; // bytes of the payloads of the collectives 
+    double* mscratch{ nullptr }; // persistent buffers for the small reductions 
 
     public:
-    /** @brief Initializes the parallel infrastructure */
+    /** @brief The values of each of the two scratch() buffers */
+    static constexpr unsigned scratch_count{ 8 }; 
+
+    /** @brief Initializes the parallel infrastructure, 
+     *  throws std::bad_alloc if the scratch() buffers cannot be allocated 
+     */
     State(); 
     
     /** @brief Finalizes the parallel infrastructure */
@@ -104,21 +111,40 @@ class State
     /** @brief Returns a handle to the Timer object used */
     const Timer<std::chrono::microseconds>& 
     timer() const noexcept { return self.mtimer; }
+    /** @brief Returns the bytes of the payloads of all the collectives (broadcasts and reductions) so far */
+    u64 communicated() const noexcept { return self.mcommunicated; }
+    /** @brief Returns the persistent scratch buffers (2 *scratch_count doubles, 
+     *  allocated once, that can be safely sent to and received from other ranks). 
+     *  Do not use, use som::parallel::sum_all(double) and the like instead 
+     */
+    double* scratch() noexcept { return self.mscratch; }
 
+    /** @brief Waits for all ranks() to reach it (not timed nor counted as communicated()) */
+    void barrier() noexcept; 
     /** @brief Sends "bytes" bytes (at memory) to all other ranks. 
      *  Do not use, use Memory<T>::broadcast() instead 
      */
-    void broadcast(void *memory, unsigned bytes, unsigned root) noexcept; 
+    void broadcast(void *memory, std::size_t bytes, unsigned root) noexcept; 
     /** @brief Sums "count" double (at src) accross all ranks() (at dst) and 
      *  sends the result to all ranks(). 
      *  Do not use, use Memory<T>::sum_all() instead 
      */
-    void sum_all(const double* src, double* dst, unsigned count) noexcept; 
+    void sum_all(const double* src, double* dst, std::size_t count) noexcept; 
     /** @brief Computes the max for "count" double (at src) accross all ranks() (at dst) and 
      *  sends the result to all ranks(). 
      *  Do not use, use Memory<T>::max_all() instead 
      */
-    void max_all(const double* src, double* dst, unsigned count) noexcept; 
+    void max_all(const double* src, double* dst, std::size_t count) noexcept; 
+    /** @brief Sums "count" float (at src) accross all ranks() (at dst) and 
+     *  sends the result to all ranks(). 
+     *  Do not use, use Memory<T>::sum_all() instead 
+     */
+    void sum_all(const float* src, float* dst, std::size_t count) noexcept; 
+    /** @brief Computes the max for "count" float (at src) accross all ranks() (at dst) and 
+     *  sends the result to all ranks(). 
+     *  Do not use, use Memory<T>::max_all() instead 
+     */
+    void max_all(const float* src, float* dst, std::size_t count) noexcept; 
 }; // class State  
 
 /* This takes care that the parallel infrastructure is initialized and it initialized only once */
@@ -144,30 +170,61 @@ const char*
 backend() noexcept 
 { return som::parallel::state.backend(); }
 
+/** @brief Waits for all ranks to reach it */
+inline 
+void 
+barrier() noexcept 
+{ som::parallel::state.barrier(); }
+
 /** @brief Returns a handle to the Timer object used by the parallel infrastructure */
 inline 
 const Timer<std::chrono::microseconds>& 
 timer() noexcept 
 { return som::parallel::state.timer(); }
 
+/** @brief Returns the bytes of the payloads of all the collectives (broadcasts and reductions) so far */
+inline 
+u64 
+communicated() noexcept 
+{ return som::parallel::state.communicated(); }
+
+
+/** @brief The Arena used by som::malloc<T>, holding memory that can be safely 
+ *  sent to and received from other ranks: under OSHMEM the symmetric allocations 
+ *  synchronize all ranks, the arena is reserved once for all the buffers of the training 
+ */
+inline 
+Arena& 
+arena() noexcept 
+{
+    static Arena arena{ parallel_malloc, parallel_free }; 
+    return arena; 
+}
+
 
 /** @brief Allocates (contiguous) memory for count elements of type T that 
- *  can be safely sent to and received from other ranks.
+ *  can be safely sent to and received from other ranks, from som::parallel::arena() 
+ *  if it fits (all ranks must allocate the same blocks in the same order). 
  *  Do not use directly, use som::parallel::Memory<T> instead  
  */
 template <class T>
 T* 
-malloc(unsigned count) noexcept 
+malloc(std::size_t count) noexcept 
 {
     assert( count > 0 );  
+    const Allocation& policy{ som::allocation() }; 
+    const std::size_t bytes{ count *sizeof(T) }; 
+    if ( void* ptr = som::parallel::arena().allocate( bytes, policy.align( bytes ) ) ) 
+        return static_cast<T*>( ptr ); 
     Context context{
-        "allocating", count *sizeof(T), 
-        "bytes with som::parallel_malloc" 
+        "allocating", bytes, 
+        "bytes with som::parallel_malloc aligned to", policy.align( bytes ) 
     }; 
     T* ptr = static_cast<T*>( 
-        parallel_malloc( count *sizeof(T) )
+        parallel_malloc( bytes, policy.align( bytes ) )
     ); 
     assert( ptr != nullptr ); 
+    policy.place( ptr, bytes ); 
     context.results( "address", ptr ); 
     return ptr; 
 }
@@ -182,6 +239,8 @@ void
 free(T* ptr) noexcept 
 {
     assert( ptr != nullptr ); 
+    if ( som::parallel::arena().owns( ptr ) ) 
+        return som::parallel::arena().deallocate( ptr ); 
     Context context{
         "freeing", ptr, 
         "with som::parallel_free" 
@@ -203,9 +262,9 @@ class Memory : public som::Memory<T>
      *  using som::parallel::malloc<T>. 
      *  Memory is freed with som::parallel::free<T>.
      */
-    Memory(unsigned count) 
+    Memory(std::size_t count) 
         : 
-        som::Memory<T>{ count, som::parallel::malloc<T>, som::parallel::free<T> } 
+        som::Memory<T>{ count, som::parallel::malloc<T>, som::parallel::free<T>, true } 
     {} 
 
     /** @brief Sends Memory<T> (from rank = root) to all other ranks */
@@ -243,6 +302,53 @@ distribute(const unsigned total) noexcept
 }
 
 
+/** @brief Sums the count (at most State::scratch_count) values accross all ranks() 
+ *  and stores the result in values, through the persistent scratch buffers 
+ */
+inline 
+void 
+sum_all(double* values, unsigned count) noexcept 
+{
+    assert( count <= State::scratch_count ); 
+    double* scratch{ som::parallel::state.scratch() }; 
+    std::copy( values, values + count, scratch ); 
+    som::parallel::state.sum_all( scratch, scratch + State::scratch_count, count ); 
+    std::copy( scratch + State::scratch_count, scratch + State::scratch_count + count, values ); 
+}
+
+/** @brief Computes the max of the count (at most State::scratch_count) values accross all ranks() 
+ *  and stores the result in values, through the persistent scratch buffers 
+ */
+inline 
+void 
+max_all(double* values, unsigned count) noexcept 
+{
+    assert( count <= State::scratch_count ); 
+    double* scratch{ som::parallel::state.scratch() }; 
+    std::copy( values, values + count, scratch ); 
+    som::parallel::state.max_all( scratch, scratch + State::scratch_count, count ); 
+    std::copy( scratch + State::scratch_count, scratch + State::scratch_count + count, values ); 
+}
+
+/** @brief Returns the sum of value accross all ranks() */
+inline 
+double 
+sum_all(double value) noexcept 
+{ 
+    som::parallel::sum_all( &value, 1 ); 
+    return value; 
+}
+
+/** @brief Returns the max of value accross all ranks() */
+inline 
+double 
+max_all(double value) noexcept 
+{ 
+    som::parallel::max_all( &value, 1 ); 
+    return value; 
+}
+
+
 /* Timer<T> methods BEGIN */
 template <class T>
 inline 
@@ -295,12 +401,9 @@ inline
 u64
 Timer<T>::max() const
 {
-    som::parallel::Memory<double> send{ 1 }; 
-    som::parallel::Memory<double> recv{ 1 }; 
-
-    *send.get() = static_cast<double>( self.total() );
-    send.max_all( recv );
-    return static_cast<u64>( *recv.get() ); 
+    return static_cast<u64>( 
+        som::parallel::max_all( static_cast<double>( self.total() ) ) 
+    ); 
 }
     
 template <class T>
@@ -326,6 +429,12 @@ State::State()
     }; 
     parallel_initialize( &self.mrank, &self.mranks ); 
     assert( self.ranks() > 0 ); 
+    self.mscratch = static_cast<double*>( 
+        parallel_malloc( 2 *scratch_count *sizeof(double), som::allocation().align( 0 ) ) 
+    ); 
+    if ( self.mscratch == nullptr ) 
+        throw std::bad_alloc{}; 
+    som::memory().inc( 2 *scratch_count *sizeof(double), MemoryCategory::scratch, true ); 
     context.results(
         "rank", self.rank(), 
         "of", self.ranks()
@@ -339,10 +448,13 @@ State::~State() noexcept
         return; 
 
     Context context{
-        "rank", self.rank(), 
+        __func__, "rank", self.rank(), 
         "of", self.ranks(),
         self.backend(), "finalizing"
     }; 
+    parallel_free( self.mscratch ); 
+    som::memory().dec( 2 *scratch_count *sizeof(double), MemoryCategory::scratch, true ); 
+    self.mscratch = nullptr; 
     parallel_finalize(); 
     self.mrank = self.mranks = 0; 
 }
@@ -350,14 +462,27 @@ State::~State() noexcept
 
 inline 
 void 
-State::broadcast(void* memory, unsigned bytes, unsigned root) noexcept
+State::barrier() noexcept 
+{
+    Context context{
+        __func__, "rank", self.rank(),  
+        "of", self.ranks(), 
+        "using", self.backend()
+    }; 
+    parallel_barrier(); 
+}
+
+
+inline 
+void 
+State::broadcast(void* memory, std::size_t bytes, unsigned root) noexcept
 {
 
     assert( memory != nullptr );   
     assert( bytes > 0 ); 
     assert( root < self.ranks() ); 
     Context context{
-        "rank", self.rank(),  
+        __func__, "rank", self.rank(),  
         "of", self.ranks(),
         "broadcasting", bytes, 
         "bytes at", memory, 
@@ -369,18 +494,19 @@ State::broadcast(void* memory, unsigned bytes, unsigned root) noexcept
         memory, bytes, root 
     );  
     self.mtimer.stop(); 
+    self.mcommunicated += bytes; 
 }
 
 
 inline 
 void 
-State::sum_all(const double* src, double* dst, unsigned count) noexcept 
+State::sum_all(const double* src, double* dst, std::size_t count) noexcept 
 {
     assert( src != nullptr );
     assert( dst != nullptr ); 
     assert( count > 0 ); 
     Context context{
-        "rank", self.rank(),  
+        __func__, "rank", self.rank(),  
         "of", self.ranks(), 
         "summing", count, 
         "doubles using", self.backend()
@@ -390,18 +516,19 @@ State::sum_all(const double* src, double* dst, unsigned count) noexcept
         src, dst, count 
     ); 
     self.mtimer.stop();  
+    self.mcommunicated += count *sizeof(double); 
 }
 
 
 inline 
 void 
-State::max_all(const double* src, double* dst, unsigned count) noexcept 
+State::max_all(const double* src, double* dst, std::size_t count) noexcept 
 {
     assert( src != nullptr );
     assert( dst != nullptr ); 
     assert( count > 0 ); 
     Context context{
-        "rank", self.rank(),  
+        __func__, "rank", self.rank(),  
         "of", self.ranks(), 
         "maxing", count, 
         "doubles using", self.backend()
@@ -411,6 +538,51 @@ State::max_all(const double* src, double* dst, unsigned count) noexcept
         src, dst, count
     ); 
     self.mtimer.stop();
+    self.mcommunicated += count *sizeof(double); 
+}
+
+
+inline 
+void 
+State::sum_all(const float* src, float* dst, std::size_t count) noexcept 
+{
+    assert( src != nullptr );
+    assert( dst != nullptr ); 
+    assert( count > 0 ); 
+    Context context{
+        __func__, "rank", self.rank(),  
+        "of", self.ranks(), 
+        "summing", count, 
+        "floats using", self.backend()
+    };
+    self.mtimer.start();  
+    parallel_sum_all_float(
+        src, dst, count 
+    ); 
+    self.mtimer.stop();  
+    self.mcommunicated += count *sizeof(float); 
+}
+
+
+inline 
+void 
+State::max_all(const float* src, float* dst, std::size_t count) noexcept 
+{
+    assert( src != nullptr );
+    assert( dst != nullptr ); 
+    assert( count > 0 ); 
+    Context context{
+        __func__, "rank", self.rank(),  
+        "of", self.ranks(), 
+        "maxing", count, 
+        "floats using", self.backend()
+    };
+    self.mtimer.start();  
+    parallel_max_all_float(
+        src, dst, count
+    ); 
+    self.mtimer.stop();
+    self.mcommunicated += count *sizeof(float); 
 }
 /* State methods END */
 
@@ -452,6 +624,32 @@ Memory<double>::max_all(som::parallel::Memory<double>& dst) const noexcept
         self.size()
     ); 
 }
+
+template <>
+inline 
+void 
+Memory<float>::sum_all(som::parallel::Memory<float>& dst) const noexcept 
+{
+    assert( self.bytes() == dst.bytes() );  
+    som::parallel::state.sum_all(
+        self.cbegin(), 
+        dst.bebin(), 
+        self.size()
+    ); 
+}
+
+template <>
+inline 
+void 
+Memory<float>::max_all(som::parallel::Memory<float>& dst) const noexcept 
+{
+    assert( self.bytes() == dst.bytes() );  
+    som::parallel::state.max_all(
+        self.cbegin(), 
+        dst.bebin(), 
+        self.size()
+    ); 
+}
 /* Memory<T> methods END */
 } // namespace parallel
 } // namespace som 
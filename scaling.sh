@@ -0,0 +1,131 @@
+#! /bin/sh 
+# DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+# 
+# Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+# You may use, distribute and modify this code under the
+# terms of the BSD 4-clause license. 
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT 
+#  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+# FITNESS FOR A PARTICULAR PURPOSE. 
+#
+# You should have received a copy of the BSD 4-clause license along 
+# with DIAPASOM; see the file LICENSE. If not see 
+# <https://en.wikipedia.org/wiki/BSD_licenses>.
+#
+#
+# Authors: 
+#     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+#     Matteo Poggi <matteo.poggi@exact-lab.it>
+#     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+#
+
+# Strong and weak scaling sweeps over the rank counts, for each version built in BINDIR: 
+#  
+#   scaling.sh [-b BINDIR] [-r "1 2 4 8"] [-n RECORDS] [-d DIMENSIONS] [-l LATTICEDIM] 
+#              [-e EPOCHS] [-o SUMMARY] [-- OTHER TRAINING PARAMETERS] 
+#  
+# The datasets are generated by diapasom-generate (a mixture of Gaussians): RECORDS records 
+# for the strong scaling, RECORDS per rank for the weak one. The time per epoch is the mean 
+# over the epochs of the one measured by the master rank (see TrainSettings::metrics()), 
+# the efficiency is relative to the smallest rank count of each version 
+# (the serial version runs with 1 rank only). 
+# The summary table is written to SUMMARY (scaling.txt by default) and to stdout. 
+# MPIRUN and OSHRUN (mpirun and oshrun by default) are the launchers of the parallel versions. 
+
+
+bindir="." 
+ranks="1 2 4" 
+records=100000 
+dimensions=16 
+latticedim=30 
+epochs=5 
+summary="scaling.txt" 
+
+while getopts "b:r:n:d:l:e:o:" option; do 
+    case "$option" in 
+        b) bindir="$OPTARG" ;; 
+        r) ranks="$OPTARG" ;; 
+        n) records="$OPTARG" ;; 
+        d) dimensions="$OPTARG" ;; 
+        l) latticedim="$OPTARG" ;; 
+        e) epochs="$OPTARG" ;; 
+        o) summary="$OPTARG" ;; 
+        *) exit 1 ;; 
+    esac 
+done 
+shift $((OPTIND - 1)) 
+[ "$1" = "--" ] && shift 
+
+bindir="$( realpath "$bindir" )" 
+workdir="$( mktemp -d )" 
+trap 'rm -rf "$workdir"' EXIT 
+
+
+# the mean time per epoch (seconds) in the metrics file $1 of a training with $2 records 
+epoch_time() { 
+    awk -F '"recordspersec":' -v records="$2" ' 
+        NF > 1 { sum += records /($2 + 0); ++epochs } 
+        END { if ( epochs > 0 ) printf "%.6f", sum /epochs; else printf "nan" }
+    ' "$1" 
+}
+
+# runs the version $1 with $2 ranks on $3 records (and the other training parameters), 
+# prints the time per epoch 
+run() { 
+    version="$1" 
+    nranks="$2" 
+    nrecords="$3" 
+    shift 3 
+
+    dataset="${workdir}/dataset${nrecords}.txt" 
+    [ -f "$dataset" ] || "${bindir}/diapasom-generate" \
+        records="$nrecords" dimensions="$dimensions" output="$dataset" 
+
+    case "$version" in 
+        serial) launcher="" ;; 
+        mpi) launcher="${MPIRUN:-mpirun} -np $nranks" ;; 
+        oshmem) launcher="${OSHRUN:-oshrun} -np $nranks" ;; 
+    esac 
+
+    metrics="${workdir}/metrics.jsonl" 
+    rm -f "$metrics" 
+    (cd "$workdir" && $launcher "${bindir}/diapasom.${version}" \
+        dataset="$dataset" latticedim="$latticedim" epochs="$epochs" rseed=1 \
+        metrics="$metrics" "$@" >/dev/null 2>&1) 
+    epoch_time "$metrics" "$nrecords" 
+}
+
+
+printf "%-8s %-8s %6s %10s %16s %10s\n" \
+    "scaling" "version" "ranks" "records" "epoch_time(s)" "efficiency" > "$summary" 
+
+for version in serial mpi oshmem; do 
+    [ -x "${bindir}/diapasom.${version}" ] || continue 
+    versionranks="$ranks" 
+    [ "$version" = "serial" ] && versionranks="1" 
+
+    for scaling in strong weak; do 
+        base="" 
+        for nranks in $versionranks; do 
+            nrecords="$records" 
+            [ "$scaling" = "weak" ] && nrecords=$((records *nranks)) 
+            time="$( run "$version" "$nranks" "$nrecords" "$@" )" 
+
+            # the efficiency is relative to the first (smallest) rank count 
+            [ -z "$base" ] && base="$time" && baseranks="$nranks" 
+            efficiency="$( awk -v scaling="$scaling" -v base="$base" -v baseranks="$baseranks" \
+                -v time="$time" -v ranks="$nranks" ' 
+                BEGIN { 
+                    if ( time + 0 <= 0 ) { print "nan"; exit } 
+                    if ( scaling == "strong" ) printf "%.3f", base *baseranks /(time *ranks); 
+                    else printf "%.3f", base /time; 
+                }' )" 
+
+            printf "%-8s %-8s %6s %10s %16s %10s\n" \
+                "$scaling" "$version" "$nranks" "$nrecords" "$time" "$efficiency" >> "$summary" 
+        done 
+    done 
+done 
+
+cat "$summary" 
@@ -0,0 +1,148 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+#ifndef SOM_COUNTERS_HPP_GUARD
+#define SOM_COUNTERS_HPP_GUARD
+
+
+#include <cstdint>
+#ifdef __linux__ 
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+
+#define self (*this)
+
+
+namespace som
+{
+
+/** @brief Simple class representing a group of hardware performance counters of the 
+ *  calling process (perf_event_open(), Linux only): cycles, instructions, last level cache 
+ *  misses and, if a raw event is supplied to open(), floating point operations. 
+ *  The counters are read together (see read()), their differences measure a region of code 
+ */
+class PerfCounters
+{
+    public:
+    /** @brief The counters of the group */
+    enum Counter : unsigned { cycles, instructions, llcmisses, fpops, count }; 
+
+    private:
+    int mfds[ count ]{ -1, -1, -1, -1 }; // the first one is the leader of the group 
+    unsigned mopened{ 0 }; 
+
+    public:
+    /** @brief PerfCounters in a disengaged state (see open()) */
+    PerfCounters() {}
+
+    ~PerfCounters() noexcept 
+    { self.close(); }
+
+    PerfCounters(const PerfCounters&) = delete; 
+    PerfCounters& operator = (const PerfCounters&) = delete; 
+
+    /** @brief Whether the counters are available (i.e., open() succeeded) */
+    bool enabled() const noexcept { return self.mopened > 0; }
+
+    /** @brief Whether the floating point operations are counted */
+    bool fpcounted() const noexcept { return self.mopened > fpops; }
+
+    /** @brief Opens and starts the counters, fpevent is the raw (model specific) event 
+     *  counting the floating point operations, 0 not to count them. 
+     *  Returns false if the counters are not available (e.g., forbidden by perf_event_paranoid) 
+     */
+    bool 
+    open(std::uint64_t fpevent) noexcept 
+    {
+        self.close(); 
+#ifdef __linux__ 
+        const std::uint32_t types[ count ]{ 
+            PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_RAW 
+        }; 
+        const std::uint64_t configs[ count ]{ 
+            PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, fpevent 
+        }; 
+        const unsigned counters{ (fpevent > 0)? count : fpops }; 
+
+        for (unsigned counter{ 0 }; counter < counters; ++counter) 
+        {
+            perf_event_attr attr{}; 
+            attr.size = sizeof(attr); 
+            attr.type = types[ counter ]; 
+            attr.config = configs[ counter ]; 
+            attr.disabled = (counter == 0); 
+            attr.exclude_kernel = 1; 
+            attr.exclude_hv = 1; 
+            attr.read_format = PERF_FORMAT_GROUP; 
+
+            self.mfds[ counter ] = static_cast<int>( 
+                syscall( SYS_perf_event_open, &attr, 0, -1, (counter == 0)? -1 : self.mfds[ 0 ], 0 ) 
+            ); 
+            if ( self.mfds[ counter ] < 0 ) 
+            {
+                self.close(); 
+                return false; 
+            }
+            self.mopened++; 
+        }
+        ioctl( self.mfds[ 0 ], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP ); 
+        ioctl( self.mfds[ 0 ], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP ); 
+        return true; 
+#else 
+        static_cast<void>( fpevent ); 
+        return false; 
+#endif
+    }
+
+    /** @brief Stops and closes the counters */
+    void 
+    close() noexcept 
+    {
+#ifdef __linux__ 
+        for (unsigned counter{ 0 }; counter < self.mopened; ++counter) 
+            ::close( self.mfds[ counter ] ); 
+#endif
+        for (unsigned counter{ 0 }; counter < count; ++counter) 
+            self.mfds[ counter ] = -1; 
+        self.mopened = 0; 
+    }
+
+    /** @brief Reads the current values of the counters (0 for the ones not counted) */
+    void 
+    read(std::uint64_t values[ count ]) const noexcept 
+    {
+        std::uint64_t buffer[ 1 + count ]{}; // the number of counters, then their values 
+#ifdef __linux__ 
+        if ( self.enabled() and ::read( self.mfds[ 0 ], buffer, sizeof(buffer) ) <= 0 ) 
+            buffer[ 0 ] = 0; 
+#endif
+        for (unsigned counter{ 0 }; counter < count; ++counter) 
+            values[ counter ] = (counter < buffer[ 0 ])? buffer[ 1 + counter ] : 0; 
+    }
+}; // class PerfCounters
+} // namespace som
+#undef self
+#endif // SOM_COUNTERS_HPP_GUARD
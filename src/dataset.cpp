@@ -62,33 +62,26 @@ valuesSum(double ranksum) noexcept
 {
     Context context{ __func__, "with ranksum", ranksum };
 
-    som::parallel::Memory<double> sendbuff{ 1 }; 
-    som::parallel::Memory<double> recvbuff{ 1 }; 
-    
-    sendbuff.get()[ 0 ] = ranksum; 
-    sendbuff.sum_all( recvbuff ); 
-    
-    const double sum{ recvbuff.get()[ 0 ]  };  
+    const double sum{ som::parallel::sum_all( ranksum ) };  
 
     context.results( "sum", sum ); 
     return sum; 
 }
 
-Dataset::Dataset(const std::string& fname, unsigned batchsize) 
+template <class Parse>
+void 
+DatasetLayout::read_lines(const std::string& fname, unsigned batchsize, Parse parse) 
 {
     Context context{ 
-        "Dataset::Dataset() with", 
+        "DatasetLayout::read_lines() with", 
         fname, batchsize 
     }; 
 
     assert( fname.size() > 0 ); // fname must be provided 
-    const unsigned dimensions{ dataset_dimensions(fname) }; // get number of dimensions (columns) 
-
     std::ifstream ifile{ fname }; 
+    if ( not ifile.is_open() )
+        throw std::runtime_error{ "could not open dataset " + fname }; 
     std::string line{};
-    std::vector<double> values{}; 
-    values.reserve( 1024 *dimensions ); 
-    double value; 
 
     /*  read the file line by line and parse it when the line (record) 
      *  pertains the current rank. 
@@ -100,7 +93,8 @@ Dataset::Dataset(const std::string& fname, unsigned batchsize)
     const unsigned rank{ self.rank() };  
     const unsigned ranks{ self.ranks() }; 
 
-    unsigned trecords; 
+    std::size_t trecords; 
+    unsigned rrecords{ 0 }; 
     double ranksum{ 0 }; 
     unsigned bidx{ 0 };   // index inside the batch
     for (trecords = 0; std::getline( ifile, line ); ++trecords) 
@@ -109,60 +103,392 @@ Dataset::Dataset(const std::string& fname, unsigned batchsize)
         { 
             context.println( "gidx and bidx", trecords, bidx );
 
-            std::istringstream iss{ line };
-            for (unsigned d{ 0 }; d < dimensions; ++d) 
-            {
-                iss >> value; 
-                values.push_back( value );
-
-                ranksum += value; 
-            }
+            parse( line, ranksum ); 
+            rrecords++; 
         }
         bidx = (bidx < batchsize - 1)? bidx + 1 : 0; 
     }
+    // the records, the batch size and the epochs are counted in unsigned 
+    if ( trecords > UINT_MAX ) 
+        throw std::runtime_error{ 
+            "dataset " + fname + " has " + std::to_string( trecords ) + " records, more than " + 
+            std::to_string( UINT_MAX ) 
+        }; 
     self.mvalmean = valuesSum( ranksum ) /static_cast<double>( trecords );
 
 
     /* initialize correctly the fields of the class */
-    self.mdimensions = dimensions; 
     self.mtrecords = trecords; 
-    self.mrrecords = values.size() /self.dimensions(); 
-    self.mbatchsize = (batchsize < UINT_MAX)? batchsize : self.trecords(); 
+    self.mrrecords = rrecords; 
+    self.mbatchsize = (batchsize < UINT_MAX)? batchsize : static_cast<unsigned>( self.trecords() ); 
     self.mrbatchsize = som::parallel::distribute( self.batchsize() );  
 
-    /* allocate mdata and copy values in mdata */
-    self.mdata = som::Memory<double>{ self.rrecords() *self.dimensions() }; 
+    context.results( 
+        "batchsize", self.batchsize(), "rbatchsize", self.rbatchsize(), 
+        "trecords", self.trecords(), "rrecords", self.rrecords() 
+    ); 
+}
+
+
+/** @brief helper function for DatasetLayout::read() and QuantizedDataset(const std::string&) 
+ *  that parses the dimensions values of line into record, scaled to unit norm if normalize 
+ *  is true, and adds them to ranksum 
+ */
+static inline 
+void 
+parse_record(const std::string& line, unsigned dimensions, bool normalize, double* record, double& ranksum) 
+{
+    std::istringstream iss{ line };
+    double sqnorm{ 0 }; 
+    for (unsigned d{ 0 }; d < dimensions; ++d) 
+    {
+        iss >> record[ d ]; 
+        sqnorm += record[ d ] *record[ d ]; 
+    }
+    
+    /* records are scaled to unit norm, once for all, when normalize is true */
+    const double scale{ (normalize and sqnorm > 0)? 1 /std::sqrt( sqnorm ) : 1 }; 
+    for (unsigned d{ 0 }; d < dimensions; ++d) 
+    {
+        record[ d ] *= scale; 
+        ranksum += record[ d ]; 
+    }
+}
+
+std::vector<double> 
+DatasetLayout::read(const std::string& fname, unsigned batchsize, bool normalize) 
+{
+    const unsigned dimensions{ dataset_dimensions(fname) }; // get number of dimensions (columns) 
+
+    std::vector<double> values{}; 
+    values.reserve( 1024 *dimensions ); 
+
+    self.read_lines( fname, batchsize, 
+        [dimensions, normalize, &values](const std::string& line, double& ranksum) 
+        {
+            const std::size_t first{ values.size() }; 
+            values.resize( first + dimensions ); 
+            parse_record( line, dimensions, normalize, values.data() + first, ranksum ); 
+        }
+    ); 
+    self.mdimensions = dimensions; 
+    return values; 
+}
+
+
+template <class T>
+Dataset<T>::Dataset(const std::string& fname, unsigned batchsize, bool normalize) 
+{
+    Context context{ 
+        "Dataset::Dataset() with", 
+        fname, batchsize, normalize 
+    }; 
+
+    const std::vector<double> values{ self.read( fname, batchsize, normalize ) }; 
+
+    /* allocate mdata and copy (converting them to T) values in mdata */
+    self.mdata = som::Memory<T>{ static_cast<std::size_t>( self.rrecords() ) *self.dimensions() }; 
     std::copy(
         values.cbegin(), 
         values.cend(), 
         self.mdata.get()
     );
-    context.results( 
-        "batchsize", self.batchsize(), "rbatchsize", self.rbatchsize(), 
-        "trecords", self.trecords(), "rrecords", self.rrecords() 
+}
+
+template <class T>
+void Dataset<T>::print(const std::string& fname) const noexcept 
+{
+    myprint::Printer printer{}; 
+    if ( fname.size() > 0 ) 
+        printer.file( fname ); 
+
+    // the records of the rank 
+    const T* record; 
+    for (unsigned lidx{ 0 }; lidx < self.rrecords(); ++lidx)
+    {
+        record = self.rrecord( lidx );
+
+        for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+            printer.print( record[ d ], " " ); 
+        printer.println( "" ); 
+    }
+}
+
+
+/** @brief helper function for QuantizedDataset(const std::string&) that turns, 
+ *  for each dimension, the min and the max of the values of the rank into the ones 
+ *  over all ranks (reducing the max of the values and the max of the negated values) 
+ */
+static inline 
+void 
+valuesRange(unsigned dimensions, double* min, double* max) noexcept 
+{
+    Context context{ __func__, "for", dimensions, "dimensions" };
+
+    som::parallel::Memory<double> sendbuff{ 2 *dimensions }; 
+    som::parallel::Memory<double> recvbuff{ 2 *dimensions }; 
+    
+    for (unsigned d{ 0 }; d < dimensions; ++d) 
+    {
+        sendbuff.get()[ d ] = max[ d ]; 
+        sendbuff.get()[ dimensions + d ] = -min[ d ]; 
+    }
+    sendbuff.max_all( recvbuff ); 
+
+    for (unsigned d{ 0 }; d < dimensions; ++d) 
+    {
+        max[ d ] = recvbuff.get()[ d ]; 
+        min[ d ] = -recvbuff.get()[ dimensions + d ]; 
+    }
+}
+
+template <class Q, class T>
+QuantizedDataset<Q, T>::QuantizedDataset(const std::string& fname, unsigned batchsize, bool normalize) 
+{
+    Context context{ 
+        "QuantizedDataset::QuantizedDataset() with", 
+        fname, batchsize, normalize, 
+        "quantizing to", 8 *sizeof(Q), "bits" 
+    }; 
+
+    /* the records are quantized while they are parsed, so that the values are never held 
+     * in double precision all at once: the file is read twice, the first time for the range 
+     * of each dimension, which is mapped to [0, qmax] */
+    const unsigned dimensions{ dataset_dimensions(fname) }; 
+    self.mdimensions = dimensions; 
+    std::vector<double> record( dimensions ); 
+    std::vector<double> min( dimensions, HUGE_VAL ); 
+    std::vector<double> max( dimensions, -HUGE_VAL ); 
+
+    self.read_lines( fname, batchsize, 
+        [dimensions, normalize, &record, &min, &max](const std::string& line, double& ranksum) 
+        {
+            parse_record( line, dimensions, normalize, record.data(), ranksum ); 
+            for (unsigned d{ 0 }; d < dimensions; ++d) 
+            {
+                min[ d ] = std::min( min[ d ], record[ d ] ); 
+                max[ d ] = std::max( max[ d ], record[ d ] ); 
+            }
+        }
+    ); 
+    valuesRange( dimensions, min.data(), max.data() ); 
+
+    const double qmax{ static_cast<double>( std::numeric_limits<Q>::max() ) }; 
+    self.mscale = som::Memory<T>{ dimensions }; 
+    self.moffset = som::Memory<T>{ dimensions }; 
+    for (unsigned d{ 0 }; d < dimensions; ++d) 
+    {
+        self.moffset.get()[ d ] = static_cast<T>( min[ d ] ); 
+        self.mscale.get()[ d ] = static_cast<T>( (max[ d ] - min[ d ]) /qmax ); 
+        context.println( "dimension", d, "offset", min[ d ], "scale", self.mscale.get()[ d ] ); 
+    }
+
+    /* allocate mdata and quantize the records in mdata, reading them again */
+    self.mdata = som::Memory<Q>{ static_cast<std::size_t>( self.rrecords() ) *dimensions }; 
+    Q* quantized{ self.mdata.get() }; 
+    self.read_lines( fname, batchsize, 
+        [dimensions, normalize, qmax, &record, &min, &max, &quantized](const std::string& line, double& ranksum) 
+        {
+            parse_record( line, dimensions, normalize, record.data(), ranksum ); 
+            double scaled; 
+            for (unsigned d{ 0 }; d < dimensions; ++d, ++quantized) 
+            {
+                scaled = (max[ d ] > min[ d ])? 
+                    (record[ d ] - min[ d ]) *qmax /(max[ d ] - min[ d ]) : 0; 
+                *quantized = static_cast<Q>( 
+                    std::min( qmax, std::max(0.0, std::round(scaled)) ) 
+                ); 
+            }
+        }
     ); 
+    assert( quantized == self.mdata.get() + self.mdata.size() ); 
 }
 
-void Dataset::print(const std::string& fname) const noexcept 
+template <class Q, class T>
+void QuantizedDataset<Q, T>::print(const std::string& fname) const noexcept 
 {
     myprint::Printer printer{}; 
     if ( fname.size() > 0 ) 
         printer.file( fname ); 
 
-    const unsigned rank{ self.rank() };
-    const unsigned ranks{ self.ranks() }; 
-    const double* record; 
-    for (unsigned idx{0}; idx < self.trecords(); ++idx)
+    for (unsigned lidx{ 0 }; lidx < self.rrecords(); ++lidx)
     {
-        if ( rank == idx % ranks ) 
+        const QuantizedRecord<Q, T> record{ self.rrecord( lidx ) }; 
+        for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+            printer.print( record[ d ], " " ); 
+        printer.println( "" ); 
+    }
+}
+
+
+template <class T>
+SparseDataset<T>::SparseDataset(const std::string& fname, unsigned batchsize) 
+{
+    Context context{ 
+        "SparseDataset::SparseDataset() with", 
+        fname, batchsize 
+    }; 
+
+    std::vector<std::size_t> rowptr{ 0 }; 
+    std::vector<unsigned> indices{}; 
+    std::vector<double> values{}; 
+    unsigned maxindex{ 0 }; 
+
+    self.read_lines( fname, batchsize, 
+        [&](const std::string& line, double& ranksum) 
         {
-            idx = idx / ranks; 
-            record = self.rrecord( idx );
+            std::istringstream iss{ line.substr(0, line.find('#')) };  // comments are skipped 
+            std::string token{}; 
+            iss >> token;   // the label 
+            
+            while (iss >> token) 
+            {
+                const auto colon = token.find( ':' ); 
+                if ( colon == std::string::npos ) 
+                    continue; 
+                if ( token.compare(0, colon, "qid") == 0 )
+                    continue; 
+
+                const unsigned index{ static_cast<unsigned>( std::stoul(token.substr(0, colon)) ) }; 
+                const double value{ std::stod(token.substr(colon + 1)) }; 
+                if ( index == 0 ) 
+                    throw std::runtime_error{ "svmlight indices start from 1 in dataset " + fname }; 
+                if ( value == 0 ) 
+                    continue; 
 
-            for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
-                printer.print( record[ d ], " " ); 
-            printer.println( "" ); 
+                indices.push_back( index - 1 ); 
+                values.push_back( value ); 
+                maxindex = std::max( maxindex, index ); 
+
+                ranksum += value; 
+            }
+            rowptr.push_back( values.size() ); 
         }
+    ); 
+
+    /* the dimensions are the largest index among all ranks */
+    self.mdimensions = static_cast<unsigned>( 
+        som::parallel::max_all( static_cast<double>( maxindex ) ) 
+    ); 
+    assert( self.dimensions() > 0 );   // a dataset with no columns is empty 
+
+    /* allocate the CSR arrays and copy in them */
+    self.mrowptr = som::Memory<std::size_t>{ self.rrecords() + 1 }; 
+    std::copy( rowptr.cbegin(), rowptr.cend(), self.mrowptr.get() ); 
+
+    self.mindices = som::Memory<unsigned>{ indices.size() }; 
+    std::copy( indices.cbegin(), indices.cend(), self.mindices.get() ); 
+
+    self.mvalues = som::Memory<T>{ values.size() }; 
+    std::copy( values.cbegin(), values.cend(), self.mvalues.get() ); 
+
+    self.msqnorms = som::Memory<T>{ self.rrecords() }; 
+    for (unsigned lidx{ 0 }; lidx < self.rrecords(); ++lidx) 
+    {
+        T sqnorm{ 0 }; 
+        for (std::size_t idx{ rowptr[ lidx ] }; idx < rowptr[ lidx + 1 ]; ++idx) 
+            sqnorm += self.mvalues.get()[ idx ] *self.mvalues.get()[ idx ]; 
+        self.msqnorms.get()[ lidx ] = sqnorm; 
     }
+
+    context.results( 
+        "dimensions", self.dimensions(), "rnonzeros", self.rnonzeros() 
+    ); 
 }
+
+template <class T>
+void SparseDataset<T>::print(const std::string& fname) const noexcept 
+{
+    myprint::Printer printer{}; 
+    if ( fname.size() > 0 ) 
+        printer.file( fname ); 
+    printer.separator( "" ); 
+
+    for (unsigned lidx{ 0 }; lidx < self.rrecords(); ++lidx)
+    {
+        const SparseRecord<T> record{ self.rrecord( lidx ) }; 
+        printer.print( 0 ); 
+        for (unsigned nz{ 0 }; nz < record.nonzeros; ++nz) 
+            printer.print( " ", record.indices[ nz ] + 1, ":", record.values[ nz ] ); 
+        printer.println( "" ); 
+    }
+}
+
+
+template <class T>
+BinaryDataset<T>::BinaryDataset(const std::string& fname, unsigned batchsize) 
+{
+    Context context{ 
+        "BinaryDataset::BinaryDataset() with", 
+        fname, batchsize 
+    }; 
+
+    const unsigned dimensions{ dataset_dimensions(fname) }; // get number of dimensions (columns) 
+    const unsigned words{ (dimensions + 63) /64 }; 
+
+    std::vector<std::uint64_t> bits{}; 
+    bits.reserve( 1024 *words ); 
+
+    self.read_lines( fname, batchsize, 
+        [dimensions, words, &bits](const std::string& line, double& ranksum) 
+        {
+            std::istringstream iss{ line };
+            double value; 
+            const std::size_t first{ bits.size() }; 
+            bits.resize( first + words, 0 ); 
+            for (unsigned d{ 0 }; d < dimensions; ++d) 
+            {
+                iss >> value; 
+                if ( value != 0 ) 
+                {
+                    bits[ first + d /64 ] |= std::uint64_t{ 1 } << (d % 64); 
+                    ranksum += 1; 
+                }
+            }
+        }
+    ); 
+    self.mdimensions = dimensions; 
+    self.mwords = words; 
+
+    /* allocate mdata and copy the packed bits in mdata */
+    self.mdata = som::Memory<std::uint64_t>{ static_cast<std::size_t>( self.rrecords() ) *self.words() }; 
+    std::copy( bits.cbegin(), bits.cend(), self.mdata.get() ); 
+
+    context.results( "words", self.words() ); 
+}
+
+template <class T>
+void BinaryDataset<T>::print(const std::string& fname) const noexcept 
+{
+    myprint::Printer printer{}; 
+    if ( fname.size() > 0 ) 
+        printer.file( fname ); 
+
+    for (unsigned lidx{ 0 }; lidx < self.rrecords(); ++lidx)
+    {
+        const BinaryRecord<T> record{ self.rrecord( lidx ) }; 
+        for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+            printer.print( record[ d ], " " ); 
+        printer.println( "" ); 
+    }
+}
+
+
+/* the value types supported by the training process, see som::Precision */
+template class Dataset<double>; 
+template class Dataset<float>; 
+
+/* the quantized storages supported by the training process, see TrainSettings::storage() */
+template class QuantizedDataset<std::uint8_t, double>; 
+template class QuantizedDataset<std::uint8_t, float>; 
+template class QuantizedDataset<std::uint16_t, double>; 
+template class QuantizedDataset<std::uint16_t, float>; 
+
+/* the sparse storage supported by the training process, see TrainSettings::storage() */
+template class SparseDataset<double>; 
+template class SparseDataset<float>; 
+
+/* the binary storage supported by the training process, see TrainSettings::storage() */
+template class BinaryDataset<double>; 
+template class BinaryDataset<float>; 
 } // namespace som
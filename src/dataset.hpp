@@ -33,32 +33,28 @@
 namespace som 
 {
 
-/** @brief Simple class representing a Dataset distributed among an arbitrary number of ranks */
-class Dataset 
+/** @brief Simple class representing how the records of a Dataset are distributed 
+ *  among an arbitrary number of ranks, regardless of how they are stored 
+ */
+class DatasetLayout 
 {
+    protected: 
     unsigned mbatchsize{ 0 };
     unsigned mrbatchsize{ 0 }; 
-    unsigned mtrecords{ 0 }; 
+    std::size_t mtrecords{ 0 }; 
     unsigned mrrecords{ 0 };
     unsigned mdimensions{ 0 }; 
     double mvalmean{ 0 }; 
-    som::Memory<double> mdata{ 0 };
 
     public: 
-    /** @brief Constructs a disengaged Dataset */ 
-    Dataset() {}
-
-    /** @brief Constructs a Dataset and populates with the records read from fname */ 
-    Dataset(const std::string& fname, unsigned batchsize); 
-    
-    Dataset(const Dataset&) = delete; 
-    Dataset& operator = (const Dataset&) = delete; 
-    Dataset(Dataset&&) noexcept = default; 
-    Dataset& operator = (Dataset&&) noexcept = default; 
+    /** @brief Whether the records are stored as sparse (see SparseDataset) */
+    static constexpr bool sparse{ false }; 
+    /** @brief Whether the records are stored as bits (see BinaryDataset) */
+    static constexpr bool binary{ false }; 
 
     getter(batchsize, unsigned, (the number of records to be added before updating the state of the Lattice))
     getter(rbatchsize, unsigned, (the batchsize of the current rank))
-    getter(trecords, unsigned, (total number of records, accross all ranks))
+    getter(trecords, std::size_t, (total number of records, accross all ranks, at most UINT_MAX))
     getter(rrecords, unsigned, (number of records for the current rank))
     getter(dimensions, unsigned, (dimensions (columns) of the dataset))
     getter(valmean, double, (mean value in the dataset))
@@ -68,22 +64,84 @@ class Dataset
     unsigned ranks() const noexcept { return som::parallel::ranks(); }
 
 
+    /** @brief Converts a global indexing (gidx) to local one (rank and lidx). 
+     *  It is you responsability to ensure that gidx < trecords() 
+     */
+    void 
+    global_to_local(std::size_t gidx, unsigned* rankp, unsigned* lidxp) const noexcept 
+    {
+        assert( gidx < self.trecords() ); 
+
+        const std::size_t batch{ gidx /self.batchsize() }; 
+        const unsigned bidx{ static_cast<unsigned>( gidx - batch *self.batchsize() ) }; 
+        const unsigned rank{ bidx % self.ranks() }; 
+        const unsigned rbatchsize{ som::parallel::distribute( self.batchsize(), rank ) }; 
+        const unsigned lidx{ static_cast<unsigned>( batch *rbatchsize + bidx /self.ranks() ) }; 
+
+        *rankp = rank; 
+        *lidxp = lidx; 
+    }
+
+    protected: 
+    /** @brief Reads fname line by line and calls parse(line, ranksum) for the lines (records) 
+     *  of the current rank, parse adds the values of the record to ranksum. 
+     *  Sets the layout accordingly (but the dimensions). 
+     */
+    template <class Parse>
+    void read_lines(const std::string& fname, unsigned batchsize, Parse parse); 
+
+    /** @brief Reads the records of the current rank from fname (space-separated values), 
+     *  sets the layout accordingly and returns the values read, 
+     *  each record is scaled to unit norm if normalize is true 
+     */
+    std::vector<double> read(const std::string& fname, unsigned batchsize, bool normalize=false); 
+}; // class DatasetLayout
+
+
+/** @brief Simple class representing a Dataset distributed among an arbitrary number of ranks, 
+ *  whose values are stored as T (double by default) 
+ */
+template <class T=double>
+class Dataset : public DatasetLayout 
+{
+    som::Memory<T> mdata{ 0 };
+
+    public: 
+    /** @brief The type of the values */
+    using value_type = T; 
+    /** @brief The type returned by rrecord() */
+    using record_type = const T*; 
+
+    /** @brief Constructs a disengaged Dataset */ 
+    Dataset() {}
+
+    /** @brief Constructs a Dataset and populates with the records read from fname, 
+     *  scaled to unit norm if normalize is true 
+     */ 
+    Dataset(const std::string& fname, unsigned batchsize, bool normalize=false); 
+    
+    Dataset(const Dataset&) = delete; 
+    Dataset& operator = (const Dataset&) = delete; 
+    Dataset(Dataset&&) noexcept = default; 
+    Dataset& operator = (Dataset&&) noexcept = default; 
+
+
     /** @brief Returns the local (to the current rank) record at index idx. 
      *  It is you responsability to ensure that idx < rrecords(). 
      */
-    const double* 
+    const T* 
     rrecord(unsigned idx) const noexcept 
     {
         assert( idx < self.rrecords() ); 
-        return self.mdata.get() + idx *self.dimensions(); 
+        return self.mdata.get() + static_cast<std::size_t>( idx ) *self.dimensions(); 
     }
 
     /** @brief Returns the global (all ranks are considered) record at index idx. 
      *  It returns nullptr if the current rank is not the one hanving the desired record.
      *  It is you responsability to ensure that idx < trecords().
      */
-    const double* 
-    grecord(unsigned idx) const noexcept 
+    const T* 
+    grecord(std::size_t idx) const noexcept 
     {
         unsigned rank, lidx;  
         self.global_to_local( idx, &rank, &lidx ); 
@@ -92,27 +150,218 @@ class Dataset
             self.rrecord( lidx ) : nullptr;      
     } 
 
-    /** @brief Converts a global indexing (gidx) to local one (rank and lidx). 
-     *  It is you responsability to ensure that gidx < trecords() 
+    /** @brief Prints the dataset to fname (if provided) or to stdout */
+    void print(const std::string& fname="") const noexcept; 
+}; // class Dataset
+
+
+/** @brief Simple class representing a record of a QuantizedDataset: 
+ *  the values are dequantized (to T) on the fly when accessed 
+ */
+template <class Q, class T>
+class QuantizedRecord 
+{
+    const Q* mvalues{ nullptr }; 
+    const T* mscale{ nullptr }; 
+    const T* moffset{ nullptr }; 
+
+    public: 
+    QuantizedRecord(const Q* values, const T* scale, const T* offset) noexcept 
+        : mvalues{ values }, 
+        mscale{ scale }, 
+        moffset{ offset } 
+    {}
+
+    /** @brief Returns the dequantized value for dimension d */
+    T operator [] (unsigned d) const noexcept 
+    { return self.moffset[ d ] + self.mscale[ d ] *static_cast<T>( self.mvalues[ d ] ); }
+}; // class QuantizedRecord
+
+
+/** @brief Simple class representing a Dataset distributed among an arbitrary number of ranks, 
+ *  whose values are quantized to the unsigned integer type Q with a scale and an offset 
+ *  (of type T) for each dimension. 
+ *  The scale and the offset are the same for all ranks. 
+ */
+template <class Q, class T=double>
+class QuantizedDataset : public DatasetLayout 
+{
+    som::Memory<Q> mdata{ 0 };
+    som::Memory<T> mscale{ 0 }; 
+    som::Memory<T> moffset{ 0 }; 
+
+    public: 
+    /** @brief The type of the dequantized values */
+    using value_type = T; 
+    /** @brief The type returned by rrecord() */
+    using record_type = QuantizedRecord<Q, T>; 
+
+    /** @brief Constructs a disengaged QuantizedDataset */ 
+    QuantizedDataset() {}
+
+    /** @brief Constructs a QuantizedDataset and populates with the records read from fname, 
+     *  scaled to unit norm (before quantization) if normalize is true. The file is read twice 
+     *  (the range of each dimension first), the records are quantized one by one while parsed 
+     */ 
+    QuantizedDataset(const std::string& fname, unsigned batchsize, bool normalize=false); 
+    
+    QuantizedDataset(const QuantizedDataset&) = delete; 
+    QuantizedDataset& operator = (const QuantizedDataset&) = delete; 
+    QuantizedDataset(QuantizedDataset&&) noexcept = default; 
+    QuantizedDataset& operator = (QuantizedDataset&&) noexcept = default; 
+
+
+    /** @brief Returns the local (to the current rank) record at index idx. 
+     *  It is you responsability to ensure that idx < rrecords(). 
      */
-    void 
-    global_to_local(unsigned gidx, unsigned* rankp, unsigned* lidxp) const noexcept 
+    QuantizedRecord<Q, T>
+    rrecord(unsigned idx) const noexcept 
     {
-        assert( gidx < self.trecords() ); 
+        assert( idx < self.rrecords() ); 
+        return QuantizedRecord<Q, T>{ 
+            self.mdata.get() + static_cast<std::size_t>( idx ) *self.dimensions(), 
+            self.mscale.get(), 
+            self.moffset.get() 
+        }; 
+    }
 
-        const unsigned batch{ gidx /self.batchsize() }; 
-        const unsigned bidx{ gidx - batch *self.batchsize() }; 
-        const unsigned rank{ bidx % self.ranks() }; 
-        const unsigned rbatchsize{ som::parallel::distribute( self.batchsize(), rank ) }; 
-        const unsigned lidx{ batch *rbatchsize + bidx /self.ranks() }; 
+    /** @brief Prints the (dequantized) local records to fname (if provided) or to stdout */
+    void print(const std::string& fname="") const noexcept; 
+}; // class QuantizedDataset
 
-        *rankp = rank; 
-        *lidxp = lidx; 
+
+/** @brief Simple class representing a record of a SparseDataset: 
+ *  only the nonzeros values are stored, together with their dimensions (indices) 
+ */
+template <class T>
+struct SparseRecord 
+{
+    const unsigned* indices{ nullptr }; 
+    const T* values{ nullptr }; 
+    unsigned nonzeros{ 0 }; 
+    T sqnorm{ 0 };  // the squared norm of the record 
+}; // struct SparseRecord
+
+
+/** @brief Simple class representing a Dataset distributed among an arbitrary number of ranks, 
+ *  whose records are stored in CSR (compressed sparse rows) format. 
+ *  The records are read from a svmlight file: "label index:value index:value ...", 
+ *  with indices starting from 1 and labels ignored. 
+ */
+template <class T=double>
+class SparseDataset : public DatasetLayout 
+{
+    som::Memory<std::size_t> mrowptr{ 0 }; // rrecords() + 1 offsets in mindices and mvalues 
+    som::Memory<unsigned> mindices{ 0 }; 
+    som::Memory<T> mvalues{ 0 }; 
+    som::Memory<T> msqnorms{ 0 };         // the squared norm of each record 
+
+    public: 
+    /** @brief Whether the records are stored as sparse */
+    static constexpr bool sparse{ true }; 
+
+    /** @brief The type of the values */
+    using value_type = T; 
+    /** @brief The type returned by rrecord() */
+    using record_type = SparseRecord<T>; 
+
+    /** @brief Constructs a disengaged SparseDataset */ 
+    SparseDataset() {}
+
+    /** @brief Constructs a SparseDataset and populates with the records read from fname */ 
+    SparseDataset(const std::string& fname, unsigned batchsize); 
+    
+    SparseDataset(const SparseDataset&) = delete; 
+    SparseDataset& operator = (const SparseDataset&) = delete; 
+    SparseDataset(SparseDataset&&) noexcept = default; 
+    SparseDataset& operator = (SparseDataset&&) noexcept = default; 
+
+
+    /** @brief Returns the local (to the current rank) record at index idx. 
+     *  It is you responsability to ensure that idx < rrecords(). 
+     */
+    SparseRecord<T>
+    rrecord(unsigned idx) const noexcept 
+    {
+        assert( idx < self.rrecords() ); 
+        const std::size_t first{ self.mrowptr.get()[ idx ] }; 
+        return SparseRecord<T>{ 
+            self.mindices.get() + first, 
+            self.mvalues.get() + first, 
+            static_cast<unsigned>( self.mrowptr.get()[ idx + 1 ] - first ), 
+            self.msqnorms.get()[ idx ] 
+        }; 
     }
 
-    /** @brief Prints the dataset to fname (if provided) or to stdout */
+    /** @brief Returns the number of nonzero values of the current rank */
+    std::size_t rnonzeros() const noexcept 
+    { return self.mvalues.size(); }
+
+    /** @brief Prints the local records (svmlight format, with label 0) to fname (if provided) or to stdout */
     void print(const std::string& fname="") const noexcept; 
-}; // class Dataset
+}; // class SparseDataset
+
+
+/** @brief Simple class representing a record of a BinaryDataset: 
+ *  one bit for each dimension, packed in 64 bits words 
+ */
+template <class T>
+struct BinaryRecord 
+{
+    const std::uint64_t* words{ nullptr }; 
+
+    /** @brief Returns the value (0 or 1) for dimension d */
+    T operator [] (unsigned d) const noexcept 
+    { return static_cast<T>( (self.words[ d /64 ] >> (d % 64)) & 1 ); }
+}; // struct BinaryRecord
+
+
+/** @brief Simple class representing a Dataset distributed among an arbitrary number of ranks, 
+ *  whose values are binary (any value different from 0 is read as 1) and stored as bits, 
+ *  packed in 64 bits words. 
+ */
+template <class T=double>
+class BinaryDataset : public DatasetLayout 
+{
+    unsigned mwords{ 0 }; 
+    som::Memory<std::uint64_t> mdata{ 0 }; 
+
+    public: 
+    /** @brief Whether the records are stored as bits */
+    static constexpr bool binary{ true }; 
+
+    /** @brief The type of the values */
+    using value_type = T; 
+    /** @brief The type returned by rrecord() */
+    using record_type = BinaryRecord<T>; 
+
+    /** @brief Constructs a disengaged BinaryDataset */ 
+    BinaryDataset() {}
+
+    /** @brief Constructs a BinaryDataset and populates with the records read from fname */ 
+    BinaryDataset(const std::string& fname, unsigned batchsize); 
+    
+    BinaryDataset(const BinaryDataset&) = delete; 
+    BinaryDataset& operator = (const BinaryDataset&) = delete; 
+    BinaryDataset(BinaryDataset&&) noexcept = default; 
+    BinaryDataset& operator = (BinaryDataset&&) noexcept = default; 
+
+    getter(words, unsigned, (number of 64 bits words for each record))
+
+
+    /** @brief Returns the local (to the current rank) record at index idx. 
+     *  It is you responsability to ensure that idx < rrecords(). 
+     */
+    BinaryRecord<T>
+    rrecord(unsigned idx) const noexcept 
+    {
+        assert( idx < self.rrecords() ); 
+        return BinaryRecord<T>{ self.mdata.get() + static_cast<std::size_t>( idx ) *self.words() }; 
+    }
+
+    /** @brief Prints the local records to fname (if provided) or to stdout */
+    void print(const std::string& fname="") const noexcept; 
+}; // class BinaryDataset
 } // namespace som  
 #undef self
 #endif // SOM_DATASET_HPP_GUARD
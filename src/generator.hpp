@@ -0,0 +1,160 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+#ifndef SOM_GENERATOR_HPP_GUARD
+#define SOM_GENERATOR_HPP_GUARD
+
+
+#include "common.hpp"
+
+#include <random>
+
+
+#define self (*this)
+
+
+namespace som
+{
+
+/** @brief The formats written by GaussianMixture::write(), i.e., the inputs of the storages 
+ *  (see TrainSettings::storage()): dense (space-separated values, for the dense, uint8 and uint16 storages), 
+ *  svmlight (for the sparse storage, the label is the cluster of the record) 
+ *  and binary (space-separated 0s and 1s, the values thresholded at 0.5, for the binary storage) 
+ */
+enum class DatasetFormat 
+{
+    dense, 
+    svmlight, 
+    binary 
+}; 
+
+
+/** @brief Simple class representing a mixture of isotropic Gaussians, with the same spread, 
+ *  centered at random in [0, 1)^dimensions: each record is drawn from a cluster chosen at random. 
+ *  Each value is kept with probability density (and is 0 otherwise), so that sparse datasets 
+ *  can be generated too. The records are drawn in memory by draw() or written to a stream by write() 
+ */
+class GaussianMixture 
+{
+    unsigned mdimensions{ 0 }; 
+    unsigned mclusters{ 0 }; 
+    double mspread{ 0 }; 
+    double mdensity{ 1 }; 
+    std::vector<double> mcenters{}; // dimensions() values for each cluster 
+    std::mt19937_64 engine{}; 
+    std::uniform_real_distribution<double> uniform{ 0, 1 }; 
+    std::normal_distribution<double> normal{ 0, 1 }; 
+
+    public: 
+    GaussianMixture(unsigned dimensions, unsigned clusters, double spread, double density, unsigned rseed) 
+        : mdimensions{ dimensions }, 
+        mclusters{ clusters }, 
+        mspread{ spread }, 
+        mdensity{ density }, 
+        engine{ rseed } 
+    {
+        if ( dimensions == 0 or clusters == 0 ) 
+            throw std::invalid_argument{ "a GaussianMixture needs at least one dimension and one cluster" }; 
+        if ( density <= 0 or density > 1 ) 
+            throw std::invalid_argument{ "density " + std::to_string( density ) + " is not in (0, 1]" }; 
+
+        self.mcenters.resize( static_cast<std::size_t>( clusters ) *dimensions ); 
+        for (double& center : self.mcenters) 
+            center = self.uniform( self.engine ); 
+    }
+
+    getter(dimensions, unsigned, (of the records))
+    getter(clusters, unsigned, (number of Gaussians))
+    getter(spread, double, (standard deviation of each Gaussian))
+    getter(density, double, (probability of a value not to be 0))
+
+    /** @brief Returns the center of cluster */
+    const double* center(unsigned cluster) const noexcept 
+    { 
+        assert( cluster < self.clusters() ); 
+        return self.mcenters.data() + static_cast<std::size_t>( cluster ) *self.dimensions(); 
+    }
+
+    /** @brief Draws a record (dimensions() values) in values, returns its cluster */
+    unsigned draw(double* values) 
+    {
+        const unsigned cluster{ 
+            std::min( static_cast<unsigned>( self.uniform( self.engine ) *self.clusters() ), self.clusters() - 1 ) 
+        }; 
+        const double* center{ self.center( cluster ) }; 
+        for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+        {
+            values[ d ] = center[ d ] + self.spread() *self.normal( self.engine ); 
+            if ( self.density() < 1 and self.uniform( self.engine ) >= self.density() ) 
+                values[ d ] = 0; 
+        }
+        return cluster; 
+    }
+
+    /** @brief Draws records records and writes them to ostream in format, one per line */
+    void write(std::ostream& ostream, std::size_t records, DatasetFormat format) 
+    {
+        std::vector<double> values( self.dimensions() ); 
+        for (std::size_t gidx{ 0 }; gidx < records; ++gidx) 
+        {
+            const unsigned cluster{ self.draw( values.data() ) }; 
+            if ( format == DatasetFormat::svmlight ) 
+            {
+                ostream << cluster; 
+                for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+                    if ( values[ d ] != 0 ) 
+                        ostream << ' ' << (d + 1) << ':' << values[ d ]; 
+            }
+            else 
+                for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+                {
+                    if ( d > 0 ) 
+                        ostream << ' '; 
+                    if ( format == DatasetFormat::binary ) 
+                        ostream << ((values[ d ] > 0.5)? 1 : 0); 
+                    else 
+                        ostream << values[ d ]; 
+                }
+            ostream << '\n'; 
+        }
+    }
+}; // class GaussianMixture
+
+
+/** @brief Returns the DatasetFormat named name (dense, svmlight or binary) */
+static inline 
+DatasetFormat 
+dataset_format(const std::string& name) 
+{
+    if ( name == "dense" ) 
+        return DatasetFormat::dense; 
+    if ( name == "svmlight" ) 
+        return DatasetFormat::svmlight; 
+    if ( name == "binary" ) 
+        return DatasetFormat::binary; 
+    throw std::invalid_argument{ 
+        "format '" + name + "' is not one of dense, svmlight or binary" 
+    }; 
+}
+} // namespace som
+#undef self
+#endif // SOM_GENERATOR_HPP_GUARD
@@ -0,0 +1,174 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+#ifndef SOM_KDTREE_HPP_GUARD
+#define SOM_KDTREE_HPP_GUARD
+
+
+#include "memory.hpp"
+
+
+#define self (*this)
+
+
+namespace som
+{
+
+/** @brief Simple class representing a kd-tree over the neurons of the Weights, 
+ *  stored implicitly: the node of the range [lo, hi) of perm is the neuron perm[mid], 
+ *  mid = (lo + hi) /2, splitting along dims[mid] the neurons of [lo, mid) (not greater) 
+ *  from the ones of [mid + 1, hi) (not smaller). Ranges up to leafsize neurons are leaves. 
+ *  The tree must be rebuilt (see build()) whenever the Weights change 
+ */
+class WeightsTree
+{
+    static constexpr unsigned leafsize{ 8 };
+
+    som::Memory<unsigned> perm{}; // the neurons, in tree order 
+    som::Memory<unsigned> dims{}; // the splitting dimension of each node 
+
+    public:
+    /** @brief WeightsTree in a disengaged state */
+    WeightsTree() {}
+    WeightsTree(unsigned neurons) 
+        : 
+        perm{ neurons }, 
+        dims{ neurons }
+    {}
+
+    /** @brief Builds the tree over the current weights, splitting each range 
+     *  along the dimension of largest extent 
+     */
+    template <class W>
+    void build(const W& weights) noexcept
+    {
+        unsigned* perm{ self.perm.get() };
+        for (unsigned index{ 0 }; index < self.perm.size(); ++index)
+            perm[ index ] = index;
+        self.build( weights, 0, self.perm.size() );
+    }
+
+    /** @brief Finds the neuron closest to record according to metric, which must be separable 
+     *  (see metrics.hpp), with the same results as bmu_find(): *bmu is the neuron tried first 
+     *  and it is then set to the BMU 
+     */
+    template <unsigned N, class M, class W, class R>
+    void nearest(const M& metric, const W& weights, const R& record, unsigned* bmu) const noexcept
+    {
+        using T = typename W::value_type;
+
+        unsigned best{ *bmu };
+        T mindist{ metric.template distance<N>( best, weights.entry(best), record, weights.dimensions() ) };
+        self.nearest<N>( metric, weights, record, 0, self.perm.size(), &best, &mindist );
+        *bmu = best;
+    }
+
+
+    private:
+    template <class W>
+    void build(const W& weights, unsigned lo, unsigned hi) noexcept
+    {
+        using T = typename W::value_type;
+
+        if ( hi - lo <= leafsize )
+            return;
+
+        unsigned* perm{ self.perm.get() };
+
+        // the dimension of largest extent 
+        unsigned dim{ 0 };
+        T extent{ -1 };
+        for (unsigned d{ 0 }; d < weights.dimensions(); ++d)
+        {
+            T min{ weights.entry( perm[lo] )[ d ] };
+            T max{ min };
+            for (unsigned idx{ lo + 1 }; idx < hi; ++idx)
+            {
+                min = std::min( min, weights.entry( perm[idx] )[ d ] );
+                max = std::max( max, weights.entry( perm[idx] )[ d ] );
+            }
+            if ( max - min > extent )
+            {
+                extent = max - min;
+                dim = d;
+            }
+        }
+
+        const unsigned mid{ (lo + hi) /2 };
+        std::nth_element( perm + lo, perm + mid, perm + hi,
+            [&weights, dim](unsigned a, unsigned b)
+            { return weights.entry( a )[ dim ] < weights.entry( b )[ dim ]; }
+        );
+        self.dims.get()[ mid ] = dim;
+
+        self.build( weights, lo, mid );
+        self.build( weights, mid + 1, hi );
+    }
+
+    template <unsigned N, class M, class W, class R, class T>
+    void nearest(const M& metric, const W& weights, const R& record, unsigned lo, unsigned hi, unsigned* best, T* mindist) const noexcept
+    {
+        const unsigned* perm{ self.perm.get() };
+
+        const auto visit = [&](unsigned index)
+        {
+            // abandoned distances are greater than mindist, ties go to the first neuron as in bmu_find()
+            const T distance{ 
+                metric.template distance<N>( index, weights.entry(index), record, weights.dimensions(), *mindist ) 
+            };
+            if ( distance < *mindist or (distance == *mindist and index < *best) )
+            {
+                *mindist = distance;
+                *best = index;
+            }
+        };
+
+        if ( hi - lo <= leafsize )
+        {
+            for (unsigned idx{ lo }; idx < hi; ++idx)
+                visit( perm[ idx ] );
+            return;
+        }
+
+        const unsigned mid{ (lo + hi) /2 };
+        const unsigned dim{ self.dims.get()[ mid ] };
+        visit( perm[ mid ] );
+
+        const T delta{ record[ dim ] - weights.entry( perm[mid] )[ dim ] };
+        if ( delta < 0 )
+        {
+            self.nearest<N>( metric, weights, record, lo, mid, best, mindist );
+            // the neurons of the far side are at least as far as the splitting plane 
+            if ( not (metric.term( dim, delta ) > *mindist) )
+                self.nearest<N>( metric, weights, record, mid + 1, hi, best, mindist );
+        }
+        else
+        {
+            self.nearest<N>( metric, weights, record, mid + 1, hi, best, mindist );
+            if ( not (metric.term( dim, delta ) > *mindist) )
+                self.nearest<N>( metric, weights, record, lo, mid, best, mindist );
+        }
+    }
+}; // class WeightsTree
+} // namespace som
+#undef self
+#endif // SOM_KDTREE_HPP_GUARD
@@ -45,6 +45,26 @@ TrainSettings::TrainSettings(const parameters::Handler& params)
     self.nradius( params.vget<double>( "nradius", 0 ) ); 
     self.rdecay( params.vget<double>( "rdecay", 1e-1 ) ); 
     self.rseed( params.vget<unsigned>( "rseed", 0 ) ); 
+    self.precision( params.vget<std::string>( "precision", "double" ) ); 
+    self.storage( params.vget<std::string>( "storage", "dense" ) ); 
+    self.metric( params.vget<std::string>( "metric", "euclidean" ) ); 
+    self.bmusearch( params.vget<std::string>( "bmusearch", "scan" ) ); 
+    self.bmuwindow( params.vget<unsigned>( "bmuwindow", 2 ) ); 
+    self.bmurescan( params.vget<unsigned>( "bmurescan", 10 ) ); 
+    self.bmusketch( params.vget<unsigned>( "bmusketch", 16 ) ); 
+    self.bmurecall( params.vget<double>( "bmurecall", 0.05 ) ); 
+    self.layout( params.vget<std::string>( "layout", "neurons" ) ); 
+    self.alignment( params.vget<unsigned>( "alignment", 64 ) ); 
+    self.hugepages( params.vget<std::string>( "hugepages", "none" ) ); 
+    self.numa( params.vget<std::string>( "numa", "none" ) ); 
+    self.trace( params.vget<std::string>( "trace", "" ) ); 
+    self.tracesize( params.vget<unsigned>( "tracesize", 1 << 16 ) ); 
+    self.counters( params.vget<std::string>( "counters", "none" ) ); 
+    self.fpevent( params.vget<std::string>( "fpevent", "0" ) ); 
+    self.metrics( params.vget<std::string>( "metrics", "" ) ); 
+    self.printformat( params.vget<std::string>( "printformat", "text" ) ); 
+    self.printmode( params.vget<std::string>( "printmode", "sync" ) ); 
+    self.printqueue( params.vget<unsigned>( "printqueue", 2 ) ); 
     
     /** if a dl is supplied epcall is read from it */
     auto dlname = params.vget<std::string>( "epcall", "" );
@@ -84,27 +104,146 @@ Lattice::epoch() const noexcept
 
 Lattice& 
 Lattice::train(const TrainSettings& settings) 
+{
+    // the allocation policy of all the memory allocated for the training, 
+    // the previous one is restored once the training is over 
+    Allocation policy{ som::allocation() }; 
+    
+    if ( settings.alignment() == 0 or (settings.alignment() & (settings.alignment() - 1)) != 0 ) 
+        throw std::invalid_argument{ 
+            "alignment " + std::to_string( settings.alignment() ) + " is not a power of 2" 
+        }; 
+    policy.alignment = settings.alignment(); 
+
+    if ( settings.hugepages() == "none" or settings.hugepages() == "advise" ) 
+        policy.hugepages = settings.hugepages() == "advise"; 
+    else 
+        throw std::invalid_argument{ 
+            "hugepages '" + settings.hugepages() + "' is not one of none or advise" 
+        }; 
+
+    if ( settings.numa() == "none" ) 
+        policy.numa = Numa::none; 
+    else if ( settings.numa() == "firsttouch" ) 
+        policy.numa = Numa::firsttouch; 
+    else if ( settings.numa() == "local" ) 
+        policy.numa = Numa::local; 
+    else 
+        throw std::invalid_argument{ 
+            "numa '" + settings.numa() + "' is not one of none, firsttouch or local" 
+        }; 
+    const AllocationScope scope{ policy }; 
+
+    if ( settings.precision() == "double" ) 
+        return self.train_<DoublePrecision>( settings ); 
+    if ( settings.precision() == "single" ) 
+        return self.train_<SinglePrecision>( settings ); 
+    if ( settings.precision() == "mixed" ) 
+        return self.train_<MixedPrecision>( settings ); 
+
+    throw std::invalid_argument{ 
+        "precision '" + settings.precision() + "' is not one of double, single or mixed" 
+    }; 
+}
+
+
+template <class P>
+Lattice& 
+Lattice::train_(const TrainSettings& settings) 
+{
+    using T = typename P::value_type; 
+
+    if ( settings.storage() == "dense" ) 
+        return self.train_<P, Dataset<T>>( settings ); 
+    if ( settings.storage() == "uint8" ) 
+        return self.train_<P, QuantizedDataset<std::uint8_t, T>>( settings ); 
+    if ( settings.storage() == "uint16" ) 
+        return self.train_<P, QuantizedDataset<std::uint16_t, T>>( settings ); 
+    if ( settings.storage() == "sparse" ) 
+        return self.train_<P, SparseDataset<T>>( settings ); 
+    if ( settings.storage() == "binary" ) 
+        return self.train_<P, BinaryDataset<T>>( settings ); 
+
+    throw std::invalid_argument{ 
+        "storage '" + settings.storage() + "' is not one of dense, uint8, uint16, sparse or binary" 
+    }; 
+}
+
+
+template <class P, class D>
+Lattice& 
+Lattice::train_(const TrainSettings& settings) 
+{
+    using T = typename P::value_type; 
+
+    if ( settings.metric() == "euclidean" ) 
+        return self.train_<P, D, Euclidean<T>>( settings ); 
+
+    if constexpr ( D::sparse or D::binary ) 
+    {
+        // sparse and binary Datasets have their own (euclidean and Hamming) BMU searches 
+        throw std::invalid_argument{ 
+            "metric '" + settings.metric() + "' is not supported with storage '" + settings.storage() + "'" 
+        }; 
+    }
+    else 
+    {
+        if ( settings.metric() == "cosine" ) 
+            return self.train_<P, D, Cosine<T>>( settings ); 
+        if ( settings.metric() == "manhattan" ) 
+            return self.train_<P, D, Manhattan<T>>( settings ); 
+        if ( settings.metric() == "mahalanobis" ) 
+            return self.train_<P, D, Mahalanobis<T>>( settings ); 
+
+        throw std::invalid_argument{ 
+            "metric '" + settings.metric() + "' is not one of euclidean, cosine, manhattan or mahalanobis" 
+        }; 
+    }
+}
+
+
+template <class P, class D, class M>
+Lattice& 
+Lattice::train_(const TrainSettings& settings) 
 {
     Context c1{ 
-        "rank", self.rank(),
+        __func__, "rank", self.rank(),
         "of", self.ranks(),
         "training process" 
     }; 
 
-    TrainState state{ self, settings }; 
+    if ( settings.trace().size() > 0 ) 
+    {
+        som::parallel::barrier(); // the ranks start tracing together 
+        myprint::tracer().enable( settings.tracesize() ); 
+    }
+
+    // the high-water marks reported (see memory_report()) are the ones of this training 
+    som::memory().reset_peaks(); 
+    TrainState_<P, D, M> state{ self, settings }; 
     self.state = &state; 
+    MetricsStream metrics{ settings.metrics() }; 
+
+    // the kernels are selected once, according to the dimensions of the Dataset 
+    const BatchKernels<P, D, M> kernels{ batch_kernels( state ) }; 
 
     state.total.start();
 
+    state.phases.start( Phase::init ); 
     weights_random_init( state ); 
+    state.phases.stop( Phase::init ); 
     
     state.epoch = 0;    
+    state.phases.start( Phase::print ); 
     self.print(); 
+    state.phases.stop( Phase::print ); 
 
     if ( settings.epcall() )
     {
         Context context{ "calling epcall(const Lattice&) for epoch", state.epoch }; 
+        state.phases.start( Phase::epcall ); 
         settings.epcall()( &self );  
+        state.phases.stop( Phase::epcall ); 
     }
 
     for (state.epoch = 1; state.epoch <= state.constants.epochs; ++state.epoch)
@@ -113,14 +252,19 @@ Lattice::train(const TrainSettings& settings)
             "epoch", state.epoch, "of", state.constants.epochs
         }; 
 
+        metrics.begin( state.phases ); 
         for (state.batch = 1; state.batch <= state.constants.batches; ++state.batch)
-            batch_present( state ); 
+            batch_present( state, kernels ); 
     
 
         // update nradius
         state.nradius = state.constants.nradius *std::exp(
             static_cast<double>( state.epoch ) *state.constants.rdecay
         );  
+        metrics.end( 
+            state.epoch, state.diff, state.nradius, 
+            state.constants.dataset.trecords(), state.phases 
+        ); 
 
         if ( state.diff < state.constants.diffmin )
             break; 
@@ -128,19 +272,36 @@ Lattice::train(const TrainSettings& settings)
         if ( settings.epcall() )
         {
             Context context{ "calling epcall(const Lattice&) for epoch", state.epoch }; 
+            state.phases.start( Phase::epcall ); 
             settings.epcall()( &self );  
+            state.phases.stop( Phase::epcall ); 
         }
         
         c2.results( "diff:", state.diff ); 
        
         myprint::outln( "epoch", state.epoch, "diff", state.diff ); 
+        if ( state.constants.bmusearch == BmuSearch::window or state.constants.bmusearch == BmuSearch::projection ) 
+            myprint::outln( "epoch", state.epoch, settings.bmusearch(), "mismatch rate", bmu_checks_report( state ) ); 
     }
     state.total.stop(); 
 
+    state.phases.start( Phase::print ); 
     self.print(); 
+    state.snapshots.flush(); // the snapshots are all written before returning 
+    state.phases.stop( Phase::print ); 
     
     myprint::outln( "training total time (microseconds):", state.total.max() ); 
     myprint::outln( "training communication time (microseconds)", som::parallel::timer().max() ); 
+    state.phases.report(); 
+    memory_report(); 
+    metrics.flush(); 
+
+    if ( settings.trace().size() > 0 ) 
+    {
+        myprint::tracer().disable(); 
+        trace_write( settings.trace() ); 
+    }
+    self.state = nullptr; 
     return self;  
 }
 
@@ -151,29 +312,19 @@ Lattice::print(const std::string& fname) const
     // only the master rank will print out the state of the Lattice 
     if ( self.rank() > 0 ) return; 
     
-    Printer printer{}; 
-    printer.file(
+    const std::string file{ 
         (fname.size() > 0)? fname :
-            "lattice" + std::to_string( self.state->epoch ) + ".out" 
-    );
+            "lattice" + std::to_string( self.state->epoch ) + 
+            ((self.state->printformat == PrintFormat::binary)? ".bin" : ".out") 
+    }; 
     
     Context context{ 
-        "rank", self.rank(), 
+        __func__, "rank", self.rank(), 
         "of", self.ranks(), 
         "printing Lattice state at epoch", self.state->epoch, 
-        "to", printer.file(), 
+        "to", file, 
     }; 
     
-    const Weights<som::Memory<double>>& weights{ self.state->weights };
-    const double* entry; 
-    for (unsigned row{ 0 }; row < weights.rows(); ++row) 
-        for (unsigned col{ 0 }; col < weights.cols(); ++col)
-        {
-            entry = weights.entry( weights.index(row, col) ); 
-            printer.print( row, col, " " ); 
-            for (unsigned d{ 0 }; d < weights.dimensions(); ++d)
-                printer.print( entry[ d ], " " ); 
-            printer.println( "" ); 
-        }
+    self.state->print( file ); 
 }
 } // namespace som
@@ -0,0 +1,349 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+#ifndef SOM_METRICS_HPP_GUARD
+#define SOM_METRICS_HPP_GUARD
+
+
+#include "dataset.hpp"
+
+
+#define self (*this)
+
+
+namespace som
+{
+
+template <class T>
+static inline
+T
+square(T a) noexcept
+{ return a*a; }
+
+/** @brief The number of dimensions of a kernel specialized for N dimensions, 
+ *  size (known at run time only) for the generic kernel (N = 0) 
+ */
+template <unsigned N>
+static inline
+constexpr unsigned
+fixed_size(unsigned size) noexcept
+{ return (N > 0)? N : size; }
+
+template <unsigned N=0, class T, class R>
+static inline
+T
+squared_distance(const T* a, const R& b, unsigned size) noexcept
+{
+    T distance{ 0 };
+    for (unsigned idx{ 0 }; idx < fixed_size<N>(size); ++idx)
+        distance += square( a[idx] - b[idx] );
+    return distance;
+}
+
+
+/** @brief Number of dimensions summed by bounded_sum() between two checks against the bound */
+constexpr unsigned abandon_block{ 8 }; 
+
+/** @brief Sums term(idx) over the (fixed_size<N>(size)) dimensions, checking the partial sum 
+ *  every abandon_block dimensions: as soon as it exceeds bound (the terms must be non-negative) 
+ *  the partial sum is returned. The summation order is the same as the one of a plain loop, 
+ *  so the result is exact whenever it does not exceed bound 
+ */
+template <unsigned N, class T, class Term>
+static inline
+T
+bounded_sum(unsigned size, T bound, Term term) noexcept
+{
+    const unsigned n{ fixed_size<N>(size) }; 
+    T sum{ 0 };
+    unsigned idx{ 0 }; 
+    for (unsigned end{ abandon_block }; end < n; end += abandon_block)
+    {
+        for (; idx < end; ++idx)
+            sum += term( idx ); 
+        if ( sum > bound )
+            return sum; 
+    }
+    for (; idx < n; ++idx)
+        sum += term( idx ); 
+    return sum; 
+}
+
+
+/* The metrics below are the policies used by bmu_find() to compare the weights of a neuron
+ * with a record, they all expose the same interface:
+ *  - normalized: whether the records must be normalized (to unit norm) at load time
+ *  - a constructor from the Dataset and the number of neurons of the Lattice
+ *  - prepare(weights): called once per batch, before the BMU searches
+ *  - distance<N>(index, entry, record, size): the distance between the weights (entry) of
+ *    the neuron index and record, smaller is closer, N > 0 is the number of dimensions 
+ *    known at compile time (see fixed_size())
+ *  - distance<N>(index, entry, record, size, bound): the same distance, that can be abandoned 
+ *    (returning any value greater than bound) once it is known to exceed bound 
+ *  - triangle: whether the metric satisfies the triangle inequality, in which case it also exposes 
+ *    - metric_value(distance): the monotone transformation of distance that satisfies it 
+ *      (e.g., the square root of the squared euclidean distance)
+ *    - length(delta, size): the metric_value() of the vector delta(idx), idx < size 
+ *  - separable: whether the distance is a sum of non-negative terms, one per dimension, 
+ *    in which case it also exposes 
+ *    - term(idx, delta): the term of dimension idx, given the difference delta along it 
+ */
+
+
+/** @brief Squared euclidean distance (the default metric) */
+template <class T>
+class Euclidean
+{
+    public:
+    static constexpr bool normalized{ false };
+    static constexpr bool triangle{ true };
+    static constexpr bool separable{ true };
+
+    template <class D>
+    Euclidean(const D&, unsigned) noexcept {}
+
+    template <class W>
+    void prepare(const W&) noexcept {}
+
+    template <unsigned N=0, class R>
+    T distance(unsigned, const T* entry, const R& record, unsigned size) const noexcept
+    { return squared_distance<N>( entry, record, size ); }
+
+    template <unsigned N=0, class R>
+    T distance(unsigned, const T* entry, const R& record, unsigned size, T bound) const noexcept
+    {
+        return bounded_sum<N>( size, bound, 
+            [entry, &record](unsigned idx) { return square( entry[idx] - record[idx] ); } 
+        ); 
+    }
+
+    double metric_value(T distance) const noexcept
+    { return std::sqrt( static_cast<double>(distance) ); }
+
+    template <class Delta>
+    double length(Delta delta, unsigned size) const noexcept
+    {
+        double sqlength{ 0 };
+        for (unsigned idx{ 0 }; idx < size; ++idx)
+            sqlength += square( static_cast<double>( delta(idx) ) );
+        return std::sqrt( sqlength );
+    }
+
+    T term(unsigned, T delta) const noexcept
+    { return square( delta ); }
+}; // class Euclidean
+
+
+/** @brief Manhattan (L1) distance */
+template <class T>
+class Manhattan
+{
+    public:
+    static constexpr bool normalized{ false };
+    static constexpr bool triangle{ true };
+    static constexpr bool separable{ true };
+
+    template <class D>
+    Manhattan(const D&, unsigned) noexcept {}
+
+    template <class W>
+    void prepare(const W&) noexcept {}
+
+    template <unsigned N=0, class R>
+    T distance(unsigned, const T* entry, const R& record, unsigned size) const noexcept
+    {
+        T distance{ 0 };
+        for (unsigned idx{ 0 }; idx < fixed_size<N>(size); ++idx)
+            distance += std::abs( entry[idx] - record[idx] );
+        return distance;
+    }
+
+    template <unsigned N=0, class R>
+    T distance(unsigned, const T* entry, const R& record, unsigned size, T bound) const noexcept
+    {
+        return bounded_sum<N>( size, bound, 
+            [entry, &record](unsigned idx) { return std::abs( entry[idx] - record[idx] ); } 
+        ); 
+    }
+
+    double metric_value(T distance) const noexcept
+    { return static_cast<double>(distance); }
+
+    template <class Delta>
+    double length(Delta delta, unsigned size) const noexcept
+    {
+        double length{ 0 };
+        for (unsigned idx{ 0 }; idx < size; ++idx)
+            length += std::abs( static_cast<double>( delta(idx) ) );
+        return length;
+    }
+
+    T term(unsigned, T delta) const noexcept
+    { return std::abs( delta ); }
+}; // class Manhattan
+
+
+/** @brief Cosine distance, 1 - cos(entry, record): the records are normalized at load time,
+ *  so that only the dot product and the (per batch) inverse norm of the weights are needed
+ */
+template <class T>
+class Cosine
+{
+    som::Memory<T> minvnorms{ 0 }; // the inverse norm of the weights of each neuron
+
+    public:
+    static constexpr bool normalized{ true };
+    static constexpr bool triangle{ false };
+    static constexpr bool separable{ false };
+
+    template <class D>
+    Cosine(const D&, unsigned neurons) 
+        : minvnorms{ neurons } 
+    {}
+
+    template <class W>
+    void prepare(const W& weights) noexcept
+    {
+        assert( self.minvnorms.size() == weights.size2() ); 
+        const T* entry;
+        T sqnorm;
+        for (unsigned index{ 0 }; index < weights.size2(); ++index)
+        {
+            entry = weights.entry( index );
+            sqnorm = 0;
+            for (unsigned d{ 0 }; d < weights.dimensions(); ++d)
+                sqnorm += square( entry[ d ] );
+            self.minvnorms.get()[ index ] = (sqnorm > 0)? T{ 1 } /std::sqrt( sqnorm ) : T{ 0 };
+        }
+    }
+
+    template <unsigned N=0, class R>
+    T distance(unsigned index, const T* entry, const R& record, unsigned size) const noexcept
+    {
+        T dot{ 0 };
+        for (unsigned idx{ 0 }; idx < fixed_size<N>(size); ++idx)
+            dot += entry[idx] *record[idx];
+        return T{ 1 } - dot *self.minvnorms.get()[ index ];
+    }
+
+    /** the dot product is not monotone, the distance cannot be abandoned */
+    template <unsigned N=0, class R>
+    T distance(unsigned index, const T* entry, const R& record, unsigned size, T) const noexcept
+    { return self.template distance<N>( index, entry, record, size ); }
+}; // class Cosine
+
+
+/** @brief Mahalanobis distance with a diagonal covariance: the squared euclidean distance
+ *  with each dimension weighted by the inverse of its variance (over all ranks) in the Dataset.
+ *  Dimensions with no variance are ignored.
+ */
+template <class T>
+class Mahalanobis
+{
+    som::Memory<T> minvvars{ 0 }; // the inverse variance of each dimension
+
+    public:
+    static constexpr bool normalized{ false };
+    static constexpr bool triangle{ true };
+    static constexpr bool separable{ true };
+
+    template <class D>
+    Mahalanobis(const D& dataset, unsigned neurons);
+
+    template <class W>
+    void prepare(const W&) noexcept {}
+
+    template <unsigned N=0, class R>
+    T distance(unsigned, const T* entry, const R& record, unsigned size) const noexcept
+    {
+        const T* invvars{ self.minvvars.get() };
+        T distance{ 0 };
+        for (unsigned idx{ 0 }; idx < fixed_size<N>(size); ++idx)
+            distance += invvars[idx] *square( entry[idx] - record[idx] );
+        return distance;
+    }
+
+    template <unsigned N=0, class R>
+    T distance(unsigned, const T* entry, const R& record, unsigned size, T bound) const noexcept
+    {
+        const T* invvars{ self.minvvars.get() };
+        return bounded_sum<N>( size, bound, 
+            [entry, &record, invvars](unsigned idx) { return invvars[idx] *square( entry[idx] - record[idx] ); } 
+        ); 
+    }
+
+    double metric_value(T distance) const noexcept
+    { return std::sqrt( static_cast<double>(distance) ); }
+
+    template <class Delta>
+    double length(Delta delta, unsigned size) const noexcept
+    {
+        const T* invvars{ self.minvvars.get() };
+        double sqlength{ 0 };
+        for (unsigned idx{ 0 }; idx < size; ++idx)
+            sqlength += static_cast<double>( invvars[idx] ) *square( static_cast<double>( delta(idx) ) );
+        return std::sqrt( sqlength );
+    }
+
+    T term(unsigned idx, T delta) const noexcept
+    { return self.minvvars.get()[ idx ] *square( delta ); }
+}; // class Mahalanobis
+
+
+template <class T>
+template <class D>
+Mahalanobis<T>::Mahalanobis(const D& dataset, unsigned)
+{
+    Context context{ "Mahalanobis::Mahalanobis" };
+
+    const unsigned dimensions{ dataset.dimensions() };
+
+    /* sums and sums of squares of each dimension, over all ranks */
+    som::parallel::Memory<double> sendbuff{ 2 *dimensions };
+    som::parallel::Memory<double> recvbuff{ 2 *dimensions };
+    double* sums{ sendbuff.get() };
+    double* sqsums{ sendbuff.get() + dimensions };
+    std::fill( sendbuff.get(), sendbuff.get() + 2 *dimensions, 0.0 );
+
+    for (unsigned lidx{ 0 }; lidx < dataset.rrecords(); ++lidx)
+    {
+        const typename D::record_type record{ dataset.rrecord( lidx ) };
+        for (unsigned d{ 0 }; d < dimensions; ++d)
+        {
+            sums[ d ] += record[ d ];
+            sqsums[ d ] += square( static_cast<double>(record[ d ]) );
+        }
+    }
+    sendbuff.sum_all( recvbuff );
+
+    const double trecords{ static_cast<double>( dataset.trecords() ) };
+    self.minvvars = som::Memory<T>{ dimensions };
+    for (unsigned d{ 0 }; d < dimensions; ++d)
+    {
+        const double mean{ recvbuff.get()[ d ] /trecords };
+        const double variance{ recvbuff.get()[ dimensions + d ] /trecords - square(mean) };
+        self.minvvars.get()[ d ] = (variance > 0)? static_cast<T>( 1 /variance ) : T{ 0 };
+        context.println( "dimension", d, "variance", variance );
+    }
+}
+} // namespace som
+#undef self
+#endif // SOM_METRICS_HPP_GUARD
@@ -24,6 +24,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <limits.h>
 
 
 static unsigned myrank = 0;
@@ -55,11 +56,22 @@ finalize()
 }
 
 
+static inline 
+void 
+barrier() 
+{
+    MPI_Barrier( MPICOMM ); 
+}
+
+
 static inline
 void* 
-pmalloc(unsigned bytes) 
+pmalloc(size_t bytes, size_t alignment) 
 {
-    return malloc( bytes );
+    void* ptr = NULL; 
+    if ( posix_memalign( &ptr, alignment, bytes ) != 0 ) 
+        return NULL; 
+    return ptr;
 }
 static inline 
 void 
@@ -69,47 +81,69 @@ pfree(void* ptr)
 }
 
 
+/* MPI counts are int: transfers above INT_MAX elements are split in chunks */
+#define CHUNK ((size_t) INT_MAX)
+
 static inline 
 void 
-broadcast(void* ptr, unsigned bytes, unsigned root) 
+broadcast(void* ptr, size_t bytes, unsigned root) 
 {
-    MPI_Bcast(
-        ptr, 
-        bytes, 
-        MPI_CHAR, 
-        root,
-        MPICOMM
-    ); 
+    for (size_t first = 0; first < bytes; first += CHUNK) 
+        MPI_Bcast(
+            (char*) ptr + first, 
+            (int) (bytes - first < CHUNK ? bytes - first : CHUNK), 
+            MPI_CHAR, 
+            root,
+            MPICOMM
+        ); 
 }
 
 
 static inline 
 void 
-sum_all_double(const double* local, double* global, unsigned count)
+allreduce(const void* local, void* global, size_t count, size_t size, MPI_Datatype type, MPI_Op op)
 {
-    MPI_Allreduce(
-        local, 
-        global, 
-        count, 
-        MPI_DOUBLE, 
-        MPI_SUM,
-        MPICOMM
-    ); 
+    for (size_t first = 0; first < count; first += CHUNK) 
+        MPI_Allreduce(
+            (const char*) local + first *size, 
+            (char*) global + first *size, 
+            (int) (count - first < CHUNK ? count - first : CHUNK), 
+            type, 
+            op,
+            MPICOMM
+        ); 
 }
 
 
 static inline 
 void 
-max_all_double(const double* local, double* global, unsigned count)
+sum_all_double(const double* local, double* global, size_t count)
 {
-    MPI_Allreduce(
-        local, 
-        global, 
-        count, 
-        MPI_DOUBLE, 
-        MPI_MAX,
-        MPICOMM
-    ); 
+    allreduce( local, global, count, sizeof(double), MPI_DOUBLE, MPI_SUM ); 
+}
+
+
+static inline 
+void 
+max_all_double(const double* local, double* global, size_t count)
+{
+    allreduce( local, global, count, sizeof(double), MPI_DOUBLE, MPI_MAX ); 
+}
+
+
+static inline 
+void 
+sum_all_float(const float* local, float* global, size_t count)
+{
+    allreduce( local, global, count, sizeof(float), MPI_FLOAT, MPI_SUM ); 
+}
+
+
+static inline 
+void 
+max_all_float(const float* local, float* global, size_t count)
+{
+    allreduce( local, global, count, sizeof(float), MPI_FLOAT, MPI_MAX ); 
 }
 
 #elif USE_PARALLEL_OSHMEM 
@@ -135,11 +169,19 @@ finalize()
 }
 
 
+static inline 
+void 
+barrier() 
+{
+    shmem_barrier_all(); 
+}
+
+
 static inline
 void* 
-pmalloc(unsigned bytes) 
+pmalloc(size_t bytes, size_t alignment) 
 {
-    return shmem_malloc( bytes );
+    return shmem_align( alignment, bytes );
 }
 static inline 
 void 
@@ -151,7 +193,7 @@ pfree(void* ptr)
 
 static inline 
 void 
-broadcast(void* ptr, unsigned bytes, unsigned root) 
+broadcast(void* ptr, size_t bytes, unsigned root) 
 {
     static long pSync[ _SHMEM_BCAST_SYNC_SIZE ];
     for (unsigned i = 0; i < _SHMEM_BCAST_SYNC_SIZE; i++) 
@@ -170,45 +212,110 @@ broadcast(void* ptr, unsigned bytes, unsigned root)
 }
 
 
+/* the reductions are split in chunks of at most REDUCE_CHUNK elements (nreduce is int), 
+ * so that their work arrays, of at least max(nreduce/2 + 1, _SHMEM_REDUCE_MIN_WRKDATA_SIZE) 
+ * elements, can be static (i.e., symmetric) and distinct from the destinations */
+#define REDUCE_CHUNK (1 << 20) 
+#define REDUCE_WRK_SIZE \
+    (REDUCE_CHUNK /2 + 1 > _SHMEM_REDUCE_MIN_WRKDATA_SIZE ? REDUCE_CHUNK /2 + 1 : _SHMEM_REDUCE_MIN_WRKDATA_SIZE) 
+
+static double pWrk_double[ REDUCE_WRK_SIZE ]; 
+static float pWrk_float[ REDUCE_WRK_SIZE ]; 
+
+
 static inline 
 void 
-sum_all_double(const double* local, double* global, unsigned count)
+sum_all_double(const double* local, double* global, size_t count)
 {
     static long pSync[ _SHMEM_REDUCE_SYNC_SIZE ];
-    for (unsigned i = 0; i < _SHMEM_BCAST_SYNC_SIZE; i++) 
-        pSync[ i ] = _SHMEM_SYNC_VALUE;
-    shmem_barrier_all(); /** wait for all ranks to initialize pSync */
+    for (size_t first = 0; first < count; first += REDUCE_CHUNK) 
+    {
+        for (unsigned i = 0; i < _SHMEM_REDUCE_SYNC_SIZE; i++) 
+            pSync[ i ] = _SHMEM_SYNC_VALUE;
+        shmem_barrier_all(); /** wait for all ranks to initialize pSync (and to be done with pWrk) */
+
+        shmem_double_sum_to_all(
+            global + first,
+            local + first, 
+            (int) (count - first < REDUCE_CHUNK ? count - first : REDUCE_CHUNK), 
+            0, 0, 
+            nranks, 
+            pWrk_double, 
+            pSync
+        ); 
+    }
+}
 
-    shmem_double_sum_to_all(
-        global,
-        local, 
-        count, 
-        0, 0, 
-        nranks, 
-        global, 
-        pSync
-    ); 
+
+static inline 
+void 
+max_all_double(const double* local, double* global, size_t count)
+{
+    static long pSync[ _SHMEM_REDUCE_SYNC_SIZE ];
+    for (size_t first = 0; first < count; first += REDUCE_CHUNK) 
+    {
+        for (unsigned i = 0; i < _SHMEM_REDUCE_SYNC_SIZE; i++) 
+            pSync[ i ] = _SHMEM_SYNC_VALUE;
+        shmem_barrier_all(); /** wait for all ranks to initialize pSync (and to be done with pWrk) */
+
+        shmem_double_max_to_all(
+            global + first,
+            local + first, 
+            (int) (count - first < REDUCE_CHUNK ? count - first : REDUCE_CHUNK), 
+            0, 0, 
+            nranks, 
+            pWrk_double, 
+            pSync
+        ); 
+    }
 }
 
 
 static inline 
 void 
-max_all_double(const double* local, double* global, unsigned count) 
+sum_all_float(const float* local, float* global, size_t count)
 {
     static long pSync[ _SHMEM_REDUCE_SYNC_SIZE ];
-    for (unsigned i = 0; i < _SHMEM_BCAST_SYNC_SIZE; i++) 
-        pSync[ i ] = _SHMEM_SYNC_VALUE;
-    shmem_barrier_all(); /** wait for all ranks to initialize pSync */
+    for (size_t first = 0; first < count; first += REDUCE_CHUNK) 
+    {
+        for (unsigned i = 0; i < _SHMEM_REDUCE_SYNC_SIZE; i++) 
+            pSync[ i ] = _SHMEM_SYNC_VALUE;
+        shmem_barrier_all(); /** wait for all ranks to initialize pSync (and to be done with pWrk) */
+
+        shmem_float_sum_to_all(
+            global + first,
+            local + first, 
+            (int) (count - first < REDUCE_CHUNK ? count - first : REDUCE_CHUNK), 
+            0, 0, 
+            nranks, 
+            pWrk_float, 
+            pSync
+        ); 
+    }
+}
 
-    shmem_double_max_to_all(
-        global,
-        local, 
-        count, 
-        0, 0, 
-        nranks, 
-        global, 
-        pSync
-    ); 
+
+static inline 
+void 
+max_all_float(const float* local, float* global, size_t count)
+{
+    static long pSync[ _SHMEM_REDUCE_SYNC_SIZE ];
+    for (size_t first = 0; first < count; first += REDUCE_CHUNK) 
+    {
+        for (unsigned i = 0; i < _SHMEM_REDUCE_SYNC_SIZE; i++) 
+            pSync[ i ] = _SHMEM_SYNC_VALUE;
+        shmem_barrier_all(); /** wait for all ranks to initialize pSync (and to be done with pWrk) */
+
+        shmem_float_max_to_all(
+            global + first,
+            local + first, 
+            (int) (count - first < REDUCE_CHUNK ? count - first : REDUCE_CHUNK), 
+            0, 0, 
+            nranks, 
+            pWrk_float, 
+            pSync
+        ); 
+    }
 }
 
 
@@ -230,11 +337,19 @@ void
 finalize() {}
 
 
+static inline 
+void 
+barrier() {}
+
+
 static inline 
 void* 
-pmalloc(unsigned bytes) 
+pmalloc(size_t bytes, size_t alignment) 
 {
-    return malloc( bytes );
+    void* ptr = NULL; 
+    if ( posix_memalign( &ptr, alignment, bytes ) != 0 ) 
+        return NULL; 
+    return ptr;
 }
 
 static inline 
@@ -247,7 +362,7 @@ pfree(void* ptr)
 
 static inline 
 void 
-broadcast(void* ptr, unsigned bytes, unsigned root) 
+broadcast(void* ptr, size_t bytes, unsigned root) 
 {
     /** completely useless operation, just to use the parameters */
     ptr = (unsigned*) ptr + bytes + root; 
@@ -256,7 +371,7 @@ broadcast(void* ptr, unsigned bytes, unsigned root)
 
 static inline 
 void 
-sum_all_double(const double* local, double* global, unsigned count)
+sum_all_double(const double* local, double* global, size_t count)
 {
     memcpy( 
         (void*) global, 
@@ -268,10 +383,30 @@ sum_all_double(const double* local, double* global, unsigned count)
 
 static inline 
 void 
-max_all_double(const double* local, double* global, unsigned count)
+max_all_double(const double* local, double* global, size_t count)
 {
     sum_all_double( local, global, count ); 
 }
+
+
+static inline 
+void 
+sum_all_float(const float* local, float* global, size_t count)
+{
+    memcpy( 
+        (void*) global, 
+        (const void*) local, 
+        count *sizeof(*local)
+    );  
+}
+
+
+static inline 
+void 
+max_all_float(const float* local, float* global, size_t count)
+{
+    sum_all_float( local, global, count ); 
+}
 #endif
 
 
@@ -298,10 +433,17 @@ parallel_backend()
 }
 
 
+void 
+parallel_barrier() 
+{
+    barrier(); 
+}
+
+
 void*
-parallel_malloc(unsigned bytes)
+parallel_malloc(size_t bytes, size_t alignment)
 {
-    return pmalloc( bytes ); 
+    return pmalloc( bytes, alignment ); 
 }
 
 void 
@@ -312,21 +454,35 @@ parallel_free(void* ptr)
 
 
 void 
-parallel_broadcast(void* ptr, unsigned bytes, unsigned root)  
+parallel_broadcast(void* ptr, size_t bytes, unsigned root)  
 {
     broadcast( ptr, bytes, root );  
 }
 
 
 void 
-parallel_sum_all_double(const double* local, double* global, unsigned count) 
+parallel_sum_all_double(const double* local, double* global, size_t count) 
 {
     sum_all_double( local, global, count ); 
 }
 
 
 void 
-parallel_max_all_double(const double* local, double* global, unsigned count) 
+parallel_max_all_double(const double* local, double* global, size_t count) 
 {
     max_all_double( local, global, count ); 
 }
+
+
+void 
+parallel_sum_all_float(const float* local, float* global, size_t count) 
+{
+    sum_all_float( local, global, count ); 
+}
+
+
+void 
+parallel_max_all_float(const float* local, float* global, size_t count) 
+{
+    max_all_float( local, global, count ); 
+}
@@ -0,0 +1,169 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+#ifndef SOM_PROJECTION_HPP_GUARD
+#define SOM_PROJECTION_HPP_GUARD
+
+
+#include <random>
+
+#include "metrics.hpp"
+
+
+#define self (*this)
+
+
+namespace som
+{
+
+/** @brief Simple class representing a random projection of the records and of the weights 
+ *  into a low-dimensional sketch, used to shortlist the candidate BMUs of a record, 
+ *  that are then re-ranked with the exact distances. 
+ *  The projection is a (scaled) random sign matrix, the same on all ranks 
+ */
+template <class T>
+class RandomProjection
+{
+    static constexpr std::uint32_t seed{ 20220101 }; // the same matrix on all ranks, whatever rseed is 
+
+    unsigned msketch{ 0 }; 
+    unsigned mdimensions{ 0 }; 
+    unsigned mcandidates{ 0 }; 
+    som::Memory<T> matrix{}; // sketch x dimensions 
+    som::Memory<T> rsketches{}; // the sketch of each record of the rank 
+    som::Memory<T> wsketches{}; // the sketch of each neuron, updated by prepare() 
+    som::Memory<T> sdists{}; // scratch: the squared distances in the sketch 
+    som::Memory<unsigned> order{}; // scratch: the neurons sorted by sdists 
+
+    public:
+    /** @brief RandomProjection in a disengaged state */
+    RandomProjection() {} 
+
+    /** @brief Sketches the records of dataset into sketch dimensions, the recall fraction 
+     *  of the neurons closest in the sketch (at least one) will be re-ranked by nearest() 
+     */
+    template <class D>
+    RandomProjection(const D& dataset, unsigned neurons, unsigned sketch, double recall); 
+
+    getter(sketch, unsigned, (dimensions of the sketch))
+    getter(candidates, unsigned, (neurons re-ranked with the exact distances))
+
+    /** @brief Sketches the current weights, called once per batch before the BMU searches */
+    template <class W>
+    void prepare(const W& weights) noexcept 
+    {
+        for (unsigned index{ 0 }; index < weights.size2(); ++index)
+            self.project( weights.entry(index), self.wsketches.get() + index *self.sketch() ); 
+    }
+
+    /** @brief Finds the neuron closest to the local record lidx according to metric among 
+     *  the candidates closest in the sketch and *bmu (the neuron tried first), 
+     *  with the same tie rule as bmu_find(); *bmu is then set to the approximate BMU 
+     */
+    template <unsigned N, class M, class W, class R>
+    void nearest(const M& metric, const W& weights, const R& record, unsigned lidx, unsigned* bmu) noexcept; 
+
+    private: 
+    template <class R>
+    void project(const R& vector, T* sketch) const noexcept 
+    {
+        const T* row{ self.matrix.get() }; 
+        for (unsigned k{ 0 }; k < self.sketch(); ++k, row += self.mdimensions) 
+        {
+            sketch[ k ] = 0; 
+            for (unsigned d{ 0 }; d < self.mdimensions; ++d) 
+                sketch[ k ] += row[ d ] *vector[ d ]; 
+        }
+    }
+}; // class RandomProjection
+
+
+template <class T>
+template <class D>
+RandomProjection<T>::RandomProjection(const D& dataset, unsigned neurons, unsigned sketch, double recall) 
+    : 
+    msketch{ sketch }, 
+    mdimensions{ dataset.dimensions() }, 
+    matrix{ sketch *dataset.dimensions() }, 
+    rsketches{ sketch *dataset.rrecords() }, 
+    wsketches{ sketch *neurons }, 
+    sdists{ neurons }, 
+    order{ neurons } 
+{
+    Context context{ "RandomProjection::RandomProjection with", sketch, recall }; 
+
+    self.mcandidates = static_cast<unsigned>( std::ceil( recall *neurons ) ); 
+    self.mcandidates = std::max( 1u, std::min( neurons, self.mcandidates ) ); 
+
+    std::mt19937 generator{ seed }; 
+    const T scale{ static_cast<T>( 1 /std::sqrt( static_cast<double>(sketch) ) ) }; 
+    for (unsigned idx{ 0 }; idx < self.matrix.size(); ++idx) 
+        self.matrix.get()[ idx ] = (generator() & 1)? scale : -scale; 
+
+    for (unsigned lidx{ 0 }; lidx < dataset.rrecords(); ++lidx)
+        self.project( dataset.rrecord(lidx), self.rsketches.get() + lidx *sketch ); 
+
+    context.results( "candidates", self.candidates() ); 
+}
+
+template <class T>
+template <unsigned N, class M, class W, class R>
+void 
+RandomProjection<T>::nearest(const M& metric, const W& weights, const R& record, unsigned lidx, unsigned* bmu) noexcept 
+{
+    const unsigned sketch{ self.sketch() }; 
+    const T* rsketch{ self.rsketches.get() + lidx *sketch }; 
+    T* sdists{ self.sdists.get() }; 
+    unsigned* order{ self.order.get() }; 
+
+    // shortlist the candidates in the sketch 
+    const T* wsketch{ self.wsketches.get() }; 
+    for (unsigned index{ 0 }; index < weights.size2(); ++index, wsketch += sketch)
+    {
+        sdists[ index ] = squared_distance( wsketch, rsketch, sketch ); 
+        order[ index ] = index; 
+    }
+    if ( self.candidates() < weights.size2() ) 
+        std::nth_element( order, order + self.candidates() - 1, order + weights.size2(), 
+            [sdists](unsigned a, unsigned b) { return sdists[ a ] < sdists[ b ]; } 
+        ); 
+
+    // and re-rank them  
+    unsigned best{ *bmu };
+    T mindist{ metric.template distance<N>( best, weights.entry(best), record, weights.dimensions() ) };
+    T distance; 
+    unsigned index; 
+    for (unsigned c{ 0 }; c < self.candidates(); ++c) 
+    {
+        index = order[ c ]; 
+        distance = metric.template distance<N>( index, weights.entry(index), record, weights.dimensions(), mindist ); 
+        if ( distance < mindist or (distance == mindist and index < best) )
+        {
+            mindist = distance;
+            best = index;
+        }
+    }
+    *bmu = best; 
+}
+} // namespace som
+#undef self
+#endif // SOM_PROJECTION_HPP_GUARD
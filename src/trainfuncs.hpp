@@ -31,31 +31,62 @@ namespace som
 
 static inline 
 double 
-square(double a) noexcept 
-{ return a*a; }
+squared_hypot(double a, double b) noexcept 
+{ return square(a) + square(b); }
 
+/** @brief Dot product between a dense vector and a SparseRecord */
+template <class T>
 static inline 
-double
-squared_distance(const double* a, const double* b, unsigned size) noexcept 
+T
+sparse_dot(const T* a, const SparseRecord<T>& b) noexcept 
 {
-    double distance{ 0 };
-    for (unsigned idx{ 0 }; idx < size; ++idx)
-        distance += square( a[idx] - b[idx] ); 
-    return distance;
+    T dot{ 0 };
+    for (unsigned nz{ 0 }; nz < b.nonzeros; ++nz)
+        dot += a[ b.indices[nz] ] *b.values[ nz ]; 
+    return dot;
 }
 
+/** @brief Squared distance between a dense vector (with squared norm asqnorm) and a SparseRecord, 
+ *  computed as ||a||^2 - 2 a.b + ||b||^2 over the nonzeros of b only 
+ */
+template <class T>
 static inline 
-double 
-squared_hypot(double a, double b) noexcept 
-{ return square(a) + square(b); }
+T
+squared_distance(const T* a, T asqnorm, const SparseRecord<T>& b) noexcept 
+{ return asqnorm - 2 *sparse_dot( a, b ) + b.sqnorm; }
+
+
+/** @brief Copies (the first size values of) a record to dst */
+template <class T, class R>
+static inline 
+void 
+record_copy(const R& record, T* dst, unsigned size) noexcept 
+{
+    for (unsigned d{ 0 }; d < size; ++d) 
+        dst[ d ] = record[ d ]; 
+}
+
+/** @brief Copies a SparseRecord (of dimensions size) to the dense vector dst */
+template <class T>
+static inline 
+void 
+record_copy(const SparseRecord<T>& record, T* dst, unsigned size) noexcept 
+{
+    std::fill( dst, dst + size, T{ 0 } ); 
+    for (unsigned nz{ 0 }; nz < record.nonzeros; ++nz) 
+        dst[ record.indices[nz] ] = record.values[ nz ]; 
+}
 
 
 
 /** @brief Initializes the weights selecting randomly records from the dataset */ 
+template <class P, class D, class M>
 static inline 
 void 
-weights_random_init(TrainState& state) noexcept 
+weights_random_init(TrainState_<P, D, M>& state) noexcept 
 {
+    using T = typename P::value_type; 
+
     Context context{ __func__ }; 
 
     if ( state.constants.rseed > 0 )
@@ -63,13 +94,12 @@ weights_random_init(TrainState& state) noexcept
     else
         std::srand( std::time(nullptr) ); 
 
-    const Dataset& dataset{ state.constants.dataset }; 
-    Weights<som::Memory<double>>& weights{ state.weights }; 
-    double* entry; 
-    const double* record; 
+    const D& dataset{ state.constants.dataset }; 
+    Weights<som::Memory<T>>& weights{ state.weights }; 
+    T* entry; 
     unsigned gidx, rank, lidx; // global and local indexing 
 
-    auto sendbuff = som::parallel::Memory<double>{ dataset.dimensions() }; // A buffer for sending data to other ranks
+    auto sendbuff = som::parallel::Memory<T>{ dataset.dimensions() }; // A buffer for sending data to other ranks
 
     for (unsigned row{ 0 }; row < weights.rows(); ++row)  
     {
@@ -82,14 +112,7 @@ weights_random_init(TrainState& state) noexcept
             context.println( gidx, rank, lidx ); 
 
             if ( state.constants.rank == rank ) 
-            {
-                record = dataset.rrecord( lidx ); 
-                std::copy(
-                    record, 
-                    record + dataset.dimensions(), 
-                    sendbuff.get()
-                ); 
-            }
+                record_copy( dataset.rrecord(lidx), sendbuff.get(), dataset.dimensions() ); 
             sendbuff.broadcast( rank );  
             std::copy(
                 sendbuff.cbegin(), 
@@ -104,21 +127,22 @@ weights_random_init(TrainState& state) noexcept
 /** @brief commits the BatchFraction to the TrainState modifying the Weights. 
  *  Returns the difference with respect to the previous batch
  */
+template <class T, class A>
 static inline 
 double 
-batch_fraction_commit(const BatchFraction& fraction, Weights<som::Memory<double>>& weights)  
+batch_fraction_commit(const BatchFraction<A>& fraction, Weights<som::Memory<T>>& weights)  
 {
-    const double* numerator{ fraction.numerator.entry(0) }; 
-    const double denominator{ *fraction.denominator.get() }; 
-    double* state{ weights.entry(0) };
+    const A* numerator{ fraction.numerator.entry(0) }; 
+    const A denominator{ *fraction.denominator.get() }; 
+    T* state{ weights.entry(0) };
     double diff{ 0 };
-    double update;
-    const unsigned size{ fraction.numerator.size3() };
+    A update;
+    const std::size_t size{ fraction.numerator.size3() };
 
-    for (unsigned idx{0}; idx < size; ++idx)
+    for (std::size_t idx{0}; idx < size; ++idx)
     {
         update = *numerator /denominator;
-        *state += update;
+        *state += static_cast<T>( update );
 
         diff += std::abs( update );
 
@@ -129,58 +153,507 @@ batch_fraction_commit(const BatchFraction& fraction, Weights<som::Memory<double>
 }
 
 
+/** @brief Finds the best matching unit of record, i.e., the neuron closest to record 
+ *  according to metric (the first one, in row-major order, in case of ties). 
+ *  The neuron *bmu (e.g., the BMU of record in the previous batch) is tried first, 
+ *  so that the distances from the other neurons can be abandoned as soon as they 
+ *  exceed the best one found so far; *bmu is then set to the BMU 
+ */
+template <unsigned N=0, class M, class T, class R>
 static inline 
 void 
-bmu_find(const Weights<som::Memory<double>>& weights, const double* record, unsigned* brow, unsigned* bcol) noexcept 
+bmu_find(const M& metric, const Weights<som::Memory<T>>& weights, const R& record, unsigned* bmu, unsigned* brow, unsigned* bcol) noexcept 
 {
-    unsigned row{ 0 };
-    unsigned col{ 0 };
-    double mindist{ 
-        squared_distance( 
-            weights.entry( weights.index(row, col) ), record, weights.dimensions()
-        )
-    };
+    assert( *bmu < weights.size2() ); 
+
+    unsigned best{ *bmu };
+    T mindist{ metric.template distance<N>( best, weights.entry(best), record, weights.dimensions() ) };
+
+    T distance;
+    for (unsigned index{ 0 }; index < weights.size2(); ++index)
+    {
+        if ( index == *bmu ) 
+            continue; 
 
-    unsigned r, c;
-    double distance;
-    for (r = 0; r < weights.rows(); ++r)
-        for (c = 0; c < weights.cols(); ++c)
+        // abandoned distances are greater than mindist, ties are computed in full 
+        // and resolved in favour of the first neuron, as in a plain scan 
+        distance = metric.template distance<N>( index, weights.entry(index), record, weights.dimensions(), mindist ); 
+        if ( distance < mindist or (distance == mindist and index < best) )
         {
-            distance = squared_distance(
-                weights.entry( weights.index(row, col) ), record, weights.dimensions()
-            );
-            if (distance < mindist)
+            mindist = distance;
+            best = index;
+        }
+    }
+    *bmu = best; 
+    *brow = best /weights.cols();
+    *bcol = best %weights.cols();
+}
+
+
+/** @brief Finds the best matching unit of record as bmu_find() does, 
+ *  together with the distance from it (mindist) and the distance from the second closest neuron (second) 
+ */
+template <unsigned N=0, class M, class T, class R>
+static inline 
+void 
+bmu_second_find(const M& metric, const Weights<som::Memory<T>>& weights, const R& record, unsigned* bmu, T* mindist, T* second) noexcept 
+{
+    assert( *bmu < weights.size2() ); 
+
+    unsigned best{ *bmu };
+    *mindist = metric.template distance<N>( best, weights.entry(best), record, weights.dimensions() );
+    *second = std::numeric_limits<T>::max(); 
+
+    T distance;
+    for (unsigned index{ 0 }; index < weights.size2(); ++index)
+    {
+        if ( index == *bmu ) 
+            continue; 
+
+        // distances greater than the second best one can be abandoned 
+        distance = metric.template distance<N>( index, weights.entry(index), record, weights.dimensions(), *second ); 
+        if ( distance < *mindist or (distance == *mindist and index < best) )
+        {
+            *second = *mindist; 
+            *mindist = distance;
+            best = index;
+        }
+        else if ( distance < *second ) 
+            *second = distance; 
+    }
+    *bmu = best; 
+}
+
+
+/** @brief Finds the best matching unit of the local record lidx using the BmuBounds of the TrainState: 
+ *  the BMU of the previous batch is kept whenever its (upper bound on the) distance is smaller than 
+ *  the lower bound on the distance from any other neuron, otherwise the bounds are recomputed with a scan. 
+ *  The bounds are widened by the rounding errors of the distances and of the drifts, so that 
+ *  the result is the same as the one of bmu_find() 
+ */
+template <unsigned N=0, class P, class D, class M>
+static inline 
+void 
+bmu_bounded_find(TrainState_<P, D, M>& state, const typename D::record_type& record, unsigned lidx, unsigned* brow, unsigned* bcol) noexcept 
+{
+    using T = typename P::value_type; 
+
+    const M& metric{ state.metric }; 
+    const Weights<som::Memory<T>>& weights{ state.weights }; 
+    unsigned* bmu{ state.bmus.get() + lidx }; 
+
+    if constexpr ( M::triangle ) 
+    {
+        BmuBounds& bounds{ state.bounds }; 
+        double& upper{ bounds.uppers.get()[ lidx ] }; 
+        double& lower{ bounds.lowers.get()[ lidx ] }; 
+        const double tol{ (weights.dimensions() + 4) *static_cast<double>( std::numeric_limits<T>::epsilon() ) }; 
+
+        const double cumdrift{ bounds.cumdrifts.get()[ *bmu ] }; 
+        const double uppernow{ upper + cumdrift + tol *(std::abs(upper) + cumdrift) }; 
+        const double lowernow{ lower - bounds.cummax - tol *(std::abs(lower) + bounds.cummax) }; 
+
+        if ( not (uppernow < lowernow) ) 
+        {
+            // tighten the upper bound with the actual distance from the BMU 
+            const double distance{ (1 + tol) *metric.metric_value( 
+                metric.template distance<N>( *bmu, weights.entry(*bmu), record, weights.dimensions() ) 
+            ) }; 
+            upper = distance - cumdrift; 
+
+            if ( not (distance < lowernow) ) 
+            {
+                T mindist, second; 
+                bmu_second_find<N>( metric, weights, record, bmu, &mindist, &second ); 
+                upper = (1 + tol) *metric.metric_value( mindist ) - bounds.cumdrifts.get()[ *bmu ]; 
+                lower = (1 - tol) *metric.metric_value( second ) + bounds.cummax; 
+            }
+        }
+        *brow = *bmu /weights.cols();
+        *bcol = *bmu %weights.cols();
+    }
+    else 
+        bmu_find<N>( metric, weights, record, bmu, brow, bcol ); 
+}
+
+
+/** @brief One record every check_stride is also searched exactly by the approximate BMU searches, 
+ *  to measure how often they miss the exact BMU (see BmuChecks) 
+ */
+constexpr unsigned check_stride{ 16 }; 
+
+/** @brief Finds approximately the best matching unit of the local record lidx searching only 
+ *  the neurons within bmuwindow cells from its BMU in the previous batch. 
+ *  All the neurons are searched (see bmu_find()) in the first epoch and every bmurescan epochs, 
+ *  or when the best neuron of the window lies on its border (but not on the border of the Lattice). 
+ *  The border test is a heuristic: a neuron outside of the window can still be closer than 
+ *  the best one of the window, one record every check_stride is checked against 
+ *  the exact BMU (see bmu_checks_report()) 
+ */
+template <unsigned N=0, class P, class D, class M>
+static inline 
+void 
+bmu_window_approximate_find(TrainState_<P, D, M>& state, const typename D::record_type& record, unsigned lidx, unsigned* brow, unsigned* bcol) noexcept 
+{
+    using T = typename P::value_type; 
+
+    const M& metric{ state.metric }; 
+    const Weights<som::Memory<T>>& weights{ state.weights }; 
+    unsigned* bmu{ state.bmus.get() + lidx }; 
+
+    const unsigned rescan{ state.constants.bmurescan }; 
+    if ( state.epoch <= 1 or (rescan > 0 and (state.epoch - 1) % rescan == 0) ) 
+    {
+        bmu_find<N>( metric, weights, record, bmu, brow, bcol ); 
+        return; 
+    }
+
+    const unsigned radius{ state.constants.bmuwindow }; 
+    const unsigned prow{ *bmu /weights.cols() }; 
+    const unsigned pcol{ *bmu %weights.cols() }; 
+    const unsigned r1{ (radius > prow)? 0 : prow -radius };
+    const unsigned c1{ (radius > pcol)? 0 : pcol -radius };
+    const unsigned r2{ std::min(prow + radius + 1, weights.rows()) };
+    const unsigned c2{ std::min(pcol + radius + 1, weights.cols()) };
+
+    unsigned best{ *bmu };
+    T mindist{ metric.template distance<N>( best, weights.entry(best), record, weights.dimensions() ) };
+
+    T distance;
+    unsigned index; 
+    for (unsigned row{ r1 }; row < r2; ++row)
+        for (unsigned col{ c1 }; col < c2; ++col)
+        {
+            index = weights.index( row, col ); 
+            if ( index == *bmu ) 
+                continue; 
+
+            distance = metric.template distance<N>( index, weights.entry(index), record, weights.dimensions(), mindist ); 
+            if ( distance < mindist or (distance == mindist and index < best) )
             {
                 mindist = distance;
-                row = r;
-                col = c;
+                best = index;
             }
         }
+
+    const unsigned row{ best /weights.cols() }; 
+    const unsigned col{ best %weights.cols() }; 
+    if ( (row == r1 and r1 > 0) or (row + 1 == r2 and r2 < weights.rows()) or 
+         (col == c1 and c1 > 0) or (col + 1 == c2 and c2 < weights.cols()) ) 
+    {
+        bmu_find<N>( metric, weights, record, bmu, brow, bcol ); 
+        return; 
+    }
+
+    if ( lidx % check_stride == 0 ) 
+    {
+        unsigned exact{ best }; 
+        unsigned erow, ecol; 
+        bmu_find<N>( metric, weights, record, &exact, &erow, &ecol ); 
+        state.checks.check( best, exact ); 
+    }
+
+    *bmu = best; 
     *brow = row;
     *bcol = col;
 }
 
+/** @brief Returns the fraction of the approximate BMUs checked (over all ranks) that differ 
+ *  from the exact ones since the previous call, then resets the counts (see BmuChecks) 
+ */
+template <class P, class D, class M>
+static inline 
+double 
+bmu_checks_report(TrainState_<P, D, M>& state) 
+{
+    double counts[ 2 ]{ state.checks.checked(), state.checks.mismatched() }; 
+    som::parallel::sum_all( counts, 2 ); 
 
-/** modify the BatchFraction to account for the new presented record */
+    state.checks.reset(); 
+    return (counts[ 0 ] > 0)? counts[ 1 ] /counts[ 0 ] : 0; 
+}
+
+
+/** @brief Finds the best matching unit of the local record lidx with the kd-tree of the TrainState 
+ *  (built at the beginning of each batch), with the same results as bmu_find() 
+ */
+template <unsigned N=0, class P, class D, class M>
+static inline 
+void 
+bmu_tree_find(TrainState_<P, D, M>& state, const typename D::record_type& record, unsigned lidx, unsigned* brow, unsigned* bcol) noexcept 
+{
+    unsigned* bmu{ state.bmus.get() + lidx }; 
+
+    if constexpr ( M::separable ) 
+    {
+        state.tree.template nearest<N>( state.metric, state.weights, record, bmu ); 
+        *brow = *bmu /state.weights.cols();
+        *bcol = *bmu %state.weights.cols();
+    }
+    else 
+        bmu_find<N>( state.metric, state.weights, record, bmu, brow, bcol ); 
+}
+
+
+/** @brief Finds (approximately) the best matching unit of the local record lidx with the 
+ *  random projection of the TrainState (see RandomProjection). 
+ *  One record every check_stride is also checked against the exact BMU (see bmu_checks_report()) 
+ */
+template <unsigned N=0, class P, class D, class M>
+static inline 
+void 
+bmu_projection_find(TrainState_<P, D, M>& state, const typename D::record_type& record, unsigned lidx, unsigned* brow, unsigned* bcol) noexcept 
+{
+    unsigned* bmu{ state.bmus.get() + lidx }; 
+    
+    unsigned exact{ *bmu }; 
+    if ( lidx % check_stride == 0 ) 
+        bmu_find<N>( state.metric, state.weights, record, &exact, brow, bcol ); 
+
+    state.projection.template nearest<N>( state.metric, state.weights, record, lidx, bmu ); 
+
+    if ( lidx % check_stride == 0 ) 
+        state.checks.check( *bmu, exact ); 
+    *brow = *bmu /state.weights.cols();
+    *bcol = *bmu %state.weights.cols();
+}
+
+/** @brief Finds the best matching unit of record scanning the InterleavedWeights (with blocks of B neurons) 
+ *  of the TrainState: the B distances from a block are accumulated together, dimension after dimension, 
+ *  with the same results as bmu_find() 
+ */
+template <unsigned B, unsigned N=0, class P, class D, class M>
+static inline 
+void 
+bmu_interleaved_find(TrainState_<P, D, M>& state, const typename D::record_type& record, unsigned lidx, unsigned* brow, unsigned* bcol) noexcept 
+{
+    using T = typename P::value_type; 
+
+    const M& metric{ state.metric }; 
+    const InterleavedWeights<T>& iweights{ state.iweights }; 
+    unsigned* bmu{ state.bmus.get() + lidx }; 
+
+    if constexpr ( M::separable ) 
+    {
+        assert( iweights.block() == B ); 
+        const unsigned dimensions{ fixed_size<N>( iweights.dimensions() ) }; 
+
+        // the BMU of the previous batch gives the first bound (see bmu_find()) 
+        unsigned best{ *bmu }; 
+        T mindist{ metric.template distance<N>( best, state.weights.entry(best), record, iweights.dimensions() ) }; 
+
+        const T* block; 
+        T distances[ B ]; 
+        T value; 
+        bool abandon; 
+        for (unsigned b{ 0 }; b < iweights.blocks(); ++b) 
+        {
+            block = iweights.block_entry( b ); 
+            for (unsigned j{ 0 }; j < B; ++j) 
+                distances[ j ] = 0; 
+
+            // the block is abandoned once all its partial distances exceed mindist 
+            abandon = false; 
+            for (unsigned d{ 0 }; d < dimensions and not abandon; d += abandon_block) 
+            {
+                const unsigned end{ std::min( d + abandon_block, dimensions ) }; 
+                for (unsigned dd{ d }; dd < end; ++dd) 
+                {
+                    value = record[ dd ]; 
+                    for (unsigned j{ 0 }; j < B; ++j) 
+                        distances[ j ] += metric.term( dd, value - block[ dd *B + j ] ); 
+                }
+                if ( end < dimensions ) 
+                {
+                    abandon = true; 
+                    for (unsigned j{ 0 }; j < B; ++j) 
+                        abandon = abandon and distances[ j ] > mindist; 
+                }
+            }
+            if ( abandon ) 
+                continue; 
+
+            const unsigned size{ std::min( B, iweights.neurons() - b *B ) }; // the last block is padded 
+            for (unsigned j{ 0 }; j < size; ++j) 
+                if ( distances[ j ] < mindist or (distances[ j ] == mindist and b *B + j < best) ) 
+                {
+                    mindist = distances[ j ]; 
+                    best = b *B + j; 
+                }
+        }
+        *bmu = best; 
+        *brow = best /state.weights.cols();
+        *bcol = best %state.weights.cols();
+    }
+    else 
+        bmu_find<N>( metric, state.weights, record, bmu, brow, bcol ); 
+}
+
+
+/** @brief Updates the BmuBounds of the TrainState with the drift of each neuron due to 
+ *  the (reduced) BatchFraction that is going to be committed, including its rounding 
+ */
+template <class P, class D, class M>
+static inline 
+void 
+bmu_bounds_drift(TrainState_<P, D, M>& state) noexcept 
+{
+    using T = typename P::value_type; 
+    using A = typename P::accumulator_type; 
+
+    if constexpr ( M::triangle ) 
+    {
+        BmuBounds& bounds{ state.bounds }; 
+        const Weights<som::Memory<T>>& weights{ state.weights }; 
+        const A denominator{ *state.bfraction.denominator.get() }; 
+        const double eps{ std::numeric_limits<T>::epsilon() }; 
+
+        const T* entry; 
+        const A* numerator; 
+        double drift; 
+        double maxdrift{ 0 }; 
+        for (unsigned index{ 0 }; index < weights.size2(); ++index)
+        {
+            entry = weights.entry( index ); 
+            numerator = state.bfraction.numerator.entry( index ); 
+            drift = state.metric.length( 
+                [entry, numerator, denominator, eps](unsigned d) 
+                { 
+                    return (1 + eps) *std::abs( static_cast<double>(numerator[ d ] /denominator) ) 
+                        + eps *std::abs( static_cast<double>(entry[ d ]) ); 
+                }, 
+                weights.dimensions() 
+            ); 
+            bounds.cumdrifts.get()[ index ] += drift; 
+            maxdrift = std::max( maxdrift, drift ); 
+        }
+        bounds.cummax += maxdrift; 
+    }
+}
+
+
+/** @brief Computes the squared norm of the weights of each neuron (for sparse Datasets) */
+template <class T>
+static inline 
+void 
+weights_sqnorms(const Weights<som::Memory<T>>& weights, T* sqnorms) noexcept 
+{
+    const T* entry; 
+    for (unsigned index{ 0 }; index < weights.size2(); ++index)
+    {
+        entry = weights.entry( index ); 
+        sqnorms[ index ] = 0; 
+        for (unsigned d{ 0 }; d < weights.dimensions(); ++d) 
+            sqnorms[ index ] += square( entry[ d ] ); 
+    }
+}
+
+/** @brief Finds the BMU for a SparseRecord, given the squared norms of the weights */
+template <class T>
+static inline 
+void 
+bmu_find(const Weights<som::Memory<T>>& weights, const T* sqnorms, const SparseRecord<T>& record, unsigned* brow, unsigned* bcol) noexcept 
+{
+    unsigned bmu{ 0 };
+    T mindist{ squared_distance( weights.entry(0), sqnorms[0], record ) };
+
+    T distance;
+    for (unsigned index{ 1 }; index < weights.size2(); ++index)
+    {
+        distance = squared_distance( weights.entry(index), sqnorms[index], record ); 
+        if (distance < mindist)
+        {
+            mindist = distance;
+            bmu = index; 
+        }
+    }
+    *brow = bmu /weights.cols();
+    *bcol = bmu % weights.cols();
+}
+
+
+/** @brief Thresholds (at 0.5) the weights of each neuron and packs them in bits, 
+ *  words 64 bits words for each neuron (for binary Datasets) 
+ */
+template <class T>
+static inline 
+void 
+weights_threshold(const Weights<som::Memory<T>>& weights, std::uint64_t* wbits, unsigned words) noexcept 
+{
+    const T* entry; 
+    std::fill( wbits, wbits + static_cast<std::size_t>( weights.size2() ) *words, std::uint64_t{ 0 } ); 
+    for (unsigned index{ 0 }; index < weights.size2(); ++index)
+    {
+        entry = weights.entry( index ); 
+        for (unsigned d{ 0 }; d < weights.dimensions(); ++d) 
+            if ( entry[ d ] >= T{ 0.5 } ) 
+                wbits[ static_cast<std::size_t>( index ) *words + d /64 ] |= std::uint64_t{ 1 } << (d % 64); 
+    }
+}
+
+/** @brief Hamming distance between two bit vectors of words 64 bits words */
+static inline 
+unsigned 
+hamming_distance(const std::uint64_t* a, const std::uint64_t* b, unsigned words) noexcept 
+{
+    unsigned distance{ 0 }; 
+    for (unsigned w{ 0 }; w < words; ++w) 
+        distance += static_cast<unsigned>( __builtin_popcountll( a[w] ^ b[w] ) ); 
+    return distance; 
+}
+
+/** @brief Finds the BMU for a BinaryRecord, given the thresholded weights packed in bits */
+template <class T>
+static inline 
+void 
+bmu_find(const Weights<som::Memory<T>>& weights, const std::uint64_t* wbits, const BinaryRecord<T>& record, unsigned* brow, unsigned* bcol) noexcept 
+{
+    const unsigned words{ (weights.dimensions() + 63) /64 }; 
+    unsigned bmu{ 0 };
+    unsigned mindist{ hamming_distance( wbits, record.words, words ) };
+
+    unsigned distance;
+    for (unsigned index{ 1 }; index < weights.size2() and mindist > 0; ++index)
+    {
+        distance = hamming_distance( wbits + index *words, record.words, words ); 
+        if (distance < mindist)
+        {
+            mindist = distance;
+            bmu = index; 
+        }
+    }
+    *brow = bmu /weights.cols();
+    *bcol = bmu % weights.cols();
+}
+
+
+/** modify the BatchFraction to account for the new presented record, 
+ *  N > 0 is the number of dimensions known at compile time (see fixed_size()) 
+ */
+template <unsigned N=0, class P, class D, class M>
 static inline 
 void
-batch_fraction_accumulate(TrainState& state, const double* record, unsigned brow, unsigned bcol) 
+batch_fraction_accumulate(TrainState_<P, D, M>& state, const typename D::record_type& record, unsigned brow, unsigned bcol) 
 {
+    using T = typename P::value_type; 
+    using A = typename P::accumulator_type; 
+
     const unsigned share{ static_cast<unsigned>(state.nradius) };
 
     const unsigned r1{ (share > brow)? 0 : brow -share };
     const unsigned c1{ (share > bcol)? 0 : bcol -share };
     const unsigned r2{ std::min(brow + share + 1, state.weights.rows()) };
     const unsigned c2{ std::min(bcol + share + 1, state.weights.cols()) };
-    const unsigned dimensions{ state.weights.dimensions() }; 
+    const unsigned dimensions{ fixed_size<N>( state.weights.dimensions() ) }; 
 
-    const double* entry;
-    double* numerator;
-    double* denominator{ state.bfraction.denominator.get() }; 
+    const T* entry;
+    A* numerator;
+    A* denominator{ state.bfraction.denominator.get() }; 
     assert( denominator ); 
     unsigned row, col, d;
     unsigned index; 
-    double sqdist, distfunc;
+    double sqdist;
+    A distfunc; 
     const double nradius{ state.nradius };
 
     for (row = r1; row < r2; ++row)
@@ -191,26 +664,80 @@ batch_fraction_accumulate(TrainState& state, const double* record, unsigned brow
             entry = state.weights.entry( index );  
             numerator = state.bfraction.numerator.entry( index );   
 
-            sqdist = squared_hypot( row -brow, col -bcol );
-            distfunc = std::exp( -sqdist / (2.0 *nradius) );
+            sqdist = squared_hypot( 
+                static_cast<double>(row) - static_cast<double>(brow), 
+                static_cast<double>(col) - static_cast<double>(bcol) 
+            );
+            distfunc = static_cast<A>( std::exp( -sqdist / (2.0 *nradius) ) );
 
             *denominator += distfunc;
-            for (d = 0; d < dimensions; ++d)
-                numerator[ d ] += distfunc *( record[ d ] - entry[ d ] );
+            if constexpr ( D::sparse ) 
+            {
+                // only distfunc *record is accumulated here, the -distfunc *entry part 
+                // is accounted for once per batch via nbsum (see batch_fraction_sparse_complete())
+                state.bfraction.nbsum.get()[ index ] += distfunc; 
+                for (d = 0; d < record.nonzeros; ++d)
+                    numerator[ record.indices[d] ] += distfunc *static_cast<A>( record.values[ d ] );
+            }
+            else 
+            {
+                for (d = 0; d < dimensions; ++d)
+                    numerator[ d ] += distfunc *( static_cast<A>(record[ d ]) - static_cast<A>(entry[ d ]) );
+            }
         }
 }
 
 
+/** @brief Completes the (reduced) BatchFraction of a sparse Dataset: 
+ *  the numerator of each neuron is decreased by the sum of its neighboring function times its weights 
+ */
+template <class T, class A>
+static inline 
+void 
+batch_fraction_sparse_complete(BatchFraction<A>& fraction, const Weights<som::Memory<T>>& weights) noexcept  
+{
+    const T* entry; 
+    A* numerator; 
+    A nbsum; 
+    for (unsigned index{ 0 }; index < weights.size2(); ++index)
+    {
+        entry = weights.entry( index ); 
+        numerator = fraction.numerator.entry( index ); 
+        nbsum = fraction.nbsum.get()[ index ]; 
+        for (unsigned d{ 0 }; d < weights.dimensions(); ++d) 
+            numerator[ d ] -= nbsum *static_cast<A>( entry[ d ] ); 
+    }
+}
+
+
+/** @brief Simple struct holding the kernels of batch_present() specialized for the number 
+ *  of dimensions of the Dataset known at compile time (see fixed_size() and batch_kernels()): 
+ *  the full scan of bmu_find() (nullptr for sparse and binary Datasets, that have their own) 
+ *  and batch_fraction_accumulate(). The other BMU searches use the generic kernels 
+ */
+template <class P, class D, class M>
+struct BatchKernels 
+{
+    using T = typename P::value_type; 
+    using R = typename D::record_type; 
+
+    void (*find)(const M&, const Weights<som::Memory<T>>&, const R&, unsigned*, unsigned*, unsigned*) noexcept{ nullptr }; 
+    void (*accumulate)(TrainState_<P, D, M>&, const R&, unsigned, unsigned){ nullptr }; 
+}; // struct BatchKernels
+
+
 /** @brief presents at most rbatchsize records to the Lattice, 
- *  modifying first the BatchFraction and then committing BatchFraction to Weights 
+ *  modifying first the BatchFraction and then committing BatchFraction to Weights. 
+ *  The BMUs of the whole batch are found before the accumulation, 
+ *  so that each phase is timed once per batch (see PhaseTimers). 
+ *  kernels are the ones selected for the Dataset by batch_kernels() 
  */
+template <class P, class D, class M>
 static inline 
 void 
-batch_present(TrainState& state) noexcept 
+batch_present(TrainState_<P, D, M>& state, const BatchKernels<P, D, M>& kernels) noexcept 
 {
-    state.bfraction.init();
-    
-    const Dataset& dataset{ state.constants.dataset }; 
+    const D& dataset{ state.constants.dataset }; 
     const unsigned first{ (state.batch - 1) *state.constants.rbatchsize }; 
     const unsigned end{ std::min(dataset.rrecords(), first + state.constants.rbatchsize) }; 
     
@@ -219,22 +746,204 @@ batch_present(TrainState& state) noexcept
         "records", first, "to", end
     };    
 
-    const double* record;
+    state.phases.start( Phase::search ); 
+    if constexpr ( D::sparse ) 
+        weights_sqnorms( state.weights, state.sqnorms.get() ); 
+    if constexpr ( D::binary ) 
+        weights_threshold( state.weights, state.wbits.get(), dataset.words() ); 
+    state.metric.prepare( state.weights ); 
+    if ( state.constants.bmusearch == BmuSearch::tree ) 
+        state.tree.build( state.weights ); 
+    if ( state.constants.bmusearch == BmuSearch::projection ) 
+        state.projection.prepare( state.weights ); 
+    if ( state.constants.wblock > 0 ) 
+        state.iweights.assign( state.weights ); 
+
+    unsigned* bbmus{ state.bbmus.get() }; 
     unsigned brow, bcol; 
     for (unsigned lidx{ first }; lidx < end; ++lidx)
     {
-        record = dataset.rrecord( lidx );    
-        context.println( "record", record[0], record[1] );
-
-        bmu_find( state.weights, record, &brow, &bcol ); 
-
-        batch_fraction_accumulate( state, record, brow, bcol ); 
+        const typename D::record_type record{ dataset.rrecord( lidx ) };    
+        context.println( "record", lidx );
+
+        if constexpr ( D::sparse ) 
+            bmu_find( state.weights, state.sqnorms.get(), record, &brow, &bcol ); 
+        else if constexpr ( D::binary ) 
+            bmu_find( state.weights, state.wbits.get(), record, &brow, &bcol ); 
+        else if ( state.constants.bmusearch == BmuSearch::bounds ) 
+            bmu_bounded_find( state, record, lidx, &brow, &bcol ); 
+        else if ( state.constants.bmusearch == BmuSearch::window ) 
+            bmu_window_approximate_find( state, record, lidx, &brow, &bcol ); 
+        else if ( state.constants.bmusearch == BmuSearch::tree ) 
+            bmu_tree_find( state, record, lidx, &brow, &bcol ); 
+        else if ( state.constants.bmusearch == BmuSearch::projection ) 
+            bmu_projection_find( state, record, lidx, &brow, &bcol ); 
+        else if ( state.constants.wblock == 8 ) 
+            bmu_interleaved_find<8>( state, record, lidx, &brow, &bcol ); 
+        else if ( state.constants.wblock == 16 ) 
+            bmu_interleaved_find<16>( state, record, lidx, &brow, &bcol ); 
+        else 
+            kernels.find( state.metric, state.weights, record, state.bmus.get() + lidx, &brow, &bcol ); 
+
+        bbmus[ lidx - first ] = state.weights.index( brow, bcol ); 
     }
+    state.phases.stop( Phase::search ); 
 
+    state.phases.start( Phase::accumulate ); 
+    state.bfraction.init();
+    const unsigned cols{ state.weights.cols() }; 
+    for (unsigned lidx{ first }; lidx < end; ++lidx)
+        kernels.accumulate( state, dataset.rrecord( lidx ), bbmus[ lidx - first ] /cols, bbmus[ lidx - first ] % cols ); 
+    state.phases.stop( Phase::accumulate ); 
+
+    state.phases.start( Phase::reduce ); 
     state.bfraction.reduce(); 
+    if constexpr ( D::sparse ) 
+        batch_fraction_sparse_complete( state.bfraction, state.weights ); 
+    state.phases.stop( Phase::reduce ); 
+
+    state.phases.start( Phase::commit ); 
+    if ( state.constants.bmusearch == BmuSearch::bounds ) 
+        bmu_bounds_drift( state ); 
 
     state.diff = batch_fraction_commit( state.bfraction, state.weights )
         /( state.constants.valmean *static_cast<double>(state.weights.size3()) ); 
+    state.phases.stop( Phase::commit ); 
+}
+
+
+/** @brief Returns the BatchKernels for N dimensions known at compile time (0 for the generic ones) */
+template <unsigned N, class P, class D, class M>
+static inline 
+BatchKernels<P, D, M> 
+batch_kernels() noexcept 
+{
+    using T = typename P::value_type; 
+    using R = typename D::record_type; 
+
+    BatchKernels<P, D, M> kernels{}; 
+    if constexpr ( not D::sparse and not D::binary ) 
+        kernels.find = &bmu_find<N, M, T, R>; 
+    kernels.accumulate = &batch_fraction_accumulate<N, P, D, M>; 
+    return kernels; 
+}
+
+/** @brief Returns the BatchKernels specialized for the number of dimensions of the Dataset 
+ *  (2, 3, 4, 8, 16, 32 or 64), the generic ones otherwise and for sparse and binary Datasets 
+ */
+template <class P, class D, class M>
+static inline 
+BatchKernels<P, D, M> 
+batch_kernels(const TrainState_<P, D, M>& state) noexcept 
+{
+    if constexpr ( D::sparse or D::binary ) 
+        return batch_kernels<0, P, D, M>(); 
+    else 
+        switch ( state.constants.dataset.dimensions() ) 
+        {
+            case 2: return batch_kernels<2, P, D, M>(); 
+            case 3: return batch_kernels<3, P, D, M>(); 
+            case 4: return batch_kernels<4, P, D, M>(); 
+            case 8: return batch_kernels<8, P, D, M>(); 
+            case 16: return batch_kernels<16, P, D, M>(); 
+            case 32: return batch_kernels<32, P, D, M>(); 
+            case 64: return batch_kernels<64, P, D, M>(); 
+            default: return batch_kernels<0, P, D, M>(); 
+        }
+}
+
+
+/** @brief Prints the high-water marks of the memory of the current rank since the start 
+ *  of the training (see som::memory()): the footprint (the Arena reservations, padding 
+ *  included, plus the blocks allocated outside of them) and the bytes of each category, 
+ *  private and symmetric apart, each as min, mean and max accross all ranks (bytes). 
+ *  All ranks must call it 
+ */
+static inline 
+void 
+memory_report() noexcept 
+{
+    constexpr unsigned categories{ static_cast<unsigned>( MemoryCategory::count ) }; 
+    static_assert( categories <= som::parallel::State::scratch_count ); 
+    const som::State& memory{ som::memory() }; 
+    const double ranks{ static_cast<double>( som::parallel::ranks() ) }; 
+
+    const double peak{ static_cast<double>( memory.peak() ) }; 
+    myprint::outln( 
+        "memory footprint peak", 
+        "min", -som::parallel::max_all( -peak ), 
+        "mean", som::parallel::sum_all( peak ) /ranks, 
+        "max", som::parallel::max_all( peak ), 
+        "(bytes)" 
+    ); 
+
+    for (const bool symmetric : { false, true }) 
+    {
+        double sums[ categories ], maxs[ categories ], negmins[ categories ]; 
+        for (unsigned idx{ 0 }; idx < categories; ++idx) 
+        {
+            sums[ idx ] = maxs[ idx ] = static_cast<double>( memory.peak( static_cast<MemoryCategory>(idx), symmetric ) ); 
+            negmins[ idx ] = -sums[ idx ]; 
+        }
+        som::parallel::sum_all( sums, categories ); 
+        som::parallel::max_all( maxs, categories ); 
+        som::parallel::max_all( negmins, categories ); 
+
+        for (unsigned idx{ 0 }; idx < categories; ++idx) 
+            myprint::outln( 
+                "memory peak", (symmetric)? "symmetric" : "private", 
+                som::State::name( static_cast<MemoryCategory>(idx) ), 
+                "min", -negmins[ idx ], 
+                "mean", sums[ idx ] /ranks, 
+                "max", maxs[ idx ], 
+                "(bytes)" 
+            ); 
+    }
+}
+
+
+/** @brief Writes the spans recorded by myprint::tracer() on all ranks to fname, in Chrome trace 
+ *  (JSON array) format with one track (process) per rank: the ranks append their spans in turn, 
+ *  all ranks must call it 
+ */
+static inline 
+void 
+trace_write(const std::string& fname) 
+{
+    Context context{ __func__, "to", fname }; 
+
+    const myprint::Tracer& tracer{ myprint::tracer() }; 
+    const unsigned rank{ som::parallel::rank() }; 
+    for (unsigned turn{ 0 }; turn < som::parallel::ranks(); ++turn) 
+    {
+        if ( turn == rank ) 
+        {
+            std::ofstream ofile{ fname, (rank == 0)? std::ios::trunc : std::ios::app }; 
+            ofile << std::fixed << std::setprecision( 3 ); // microseconds 
+            if ( rank == 0 ) 
+                ofile << "[\n"; 
+            else 
+                ofile << ",\n"; 
+            ofile << R"({"name":"process_name","ph":"M","pid":)" << rank 
+                << R"(,"tid":0,"args":{"name":"rank )" << rank << R"("}})"; 
+            
+            tracer.for_each( 
+                [&ofile, rank](const myprint::TraceEvent& event) 
+                {
+                    ofile << ",\n" << R"({"name":")"; 
+                    for (const char* c{ event.name }; *c != '\0'; ++c) 
+                        ofile << ((*c == '"' or *c == '\\')? "\\" : "") << *c; 
+                    ofile << R"(","ph":"X","pid":)" << rank << R"(,"tid":0,"ts":)" 
+                        << static_cast<double>( event.start ) /1e3 
+                        << R"(,"dur":)" << static_cast<double>( event.duration ) /1e3 << "}"; 
+                } 
+            ); 
+            if ( rank == som::parallel::ranks() - 1 ) 
+                ofile << "\n]\n"; 
+            context.results( "spans", tracer.size(), "dropped", tracer.dropped() ); 
+        }
+        som::parallel::barrier(); // the next rank appends once this one is done 
+    }
 }
 } // namespace som
 #endif // SOM_TRAINFUNCS_HPP_GUARD
@@ -23,9 +23,14 @@
 #define SOM_TRAINSTATE_HPP_GUARD
 
 
+#include "counters.hpp"
 #include "dataset.hpp"
+#include "kdtree.hpp"
 #include "lattice.hpp"
+#include "metrics.hpp"
 #include "parallel.hpp"
+#include "projection.hpp"
+#include "writer.hpp"
 
 
 #define self (*this)
@@ -34,6 +39,25 @@
 namespace som 
 {
 
+/** @brief Simple class representing the precision of the training process: 
+ *  T is the type used to store the Dataset and the Weights, 
+ *  A is the type of the accumulators (the BatchFraction) 
+ */
+template <class T, class A>
+struct Precision 
+{
+    using value_type = T; 
+    using accumulator_type = A; 
+}; 
+
+/** @brief Dataset, Weights and BatchFraction in double (the default) */
+using DoublePrecision = Precision<double, double>; 
+/** @brief Dataset, Weights and BatchFraction in float */
+using SinglePrecision = Precision<float, float>; 
+/** @brief Dataset and Weights in float, BatchFraction in double */
+using MixedPrecision = Precision<float, double>; 
+
+
 /** 
  * @brief Simple class representing the state (the weights) of the Lattice. 
  * This class is private to lattice.cpp
@@ -41,12 +65,17 @@ namespace som
 template <class Memory=som::Memory<double>>
 class Weights 
 {
+    using T = typename Memory::value_type; 
+
     unsigned mrows{ 0 };
     unsigned mcols{ 0 };
     unsigned mdimensions{ 0 }; 
     Memory mem{ 0 }; 
 
     public:
+    /** @brief The type of the weights */
+    using value_type = T; 
+
     /** @brief Weights in a disengaged state */
     Weights() {} 
     Weights(unsigned rows, unsigned cols, unsigned dimensions) 
@@ -73,8 +102,8 @@ class Weights
     unsigned size2() const noexcept 
     { return self.rows() *self.cols(); }
 
-    unsigned size3() const noexcept 
-    { return self.size2() *self.dimensions(); }
+    std::size_t size3() const noexcept 
+    { return static_cast<std::size_t>( self.size2() ) *self.dimensions(); }
 
 
     unsigned index(unsigned row, unsigned col) const noexcept 
@@ -84,20 +113,20 @@ class Weights
         return row *self.cols() + col; 
     }
     
-    unsigned offset(unsigned row, unsigned col) const noexcept 
+    std::size_t offset(unsigned row, unsigned col) const noexcept 
     { 
         return self.offset( self.index(row, col) ); 
     }
-    unsigned offset(unsigned index) const noexcept 
+    std::size_t offset(unsigned index) const noexcept 
     { 
         assert( index < self.size2() ); 
-        return index *self.dimensions(); 
+        return static_cast<std::size_t>( index ) *self.dimensions(); 
     }
 
-    double* entry(unsigned index) noexcept 
+    T* entry(unsigned index) noexcept 
     { return self.memory().get() + self.offset(index); }
     
-    const double* entry(unsigned index) const noexcept 
+    const T* entry(unsigned index) const noexcept 
     { return self.memory().get() + self.offset(index); }
 
     
@@ -106,31 +135,110 @@ class Weights
 }; // class Weights
 
 
+/** 
+ * @brief Simple class representing the Weights in a neuron-interleaved layout: 
+ * the neurons are grouped in blocks of block() neurons and, inside each block, 
+ * the values of each dimension are contiguous (the last block is padded), so that 
+ * the distances from a whole block can be computed together (see bmu_interleaved_find()). 
+ * It is a transposed copy of the Weights, refreshed by assign() whenever they change, 
+ * while the Weights keep the neuron-major layout used by the update and by print() 
+ */
+template <class T>
+class InterleavedWeights 
+{
+    unsigned mblock{ 0 }; 
+    unsigned mneurons{ 0 }; 
+    unsigned mdimensions{ 0 }; 
+    som::Memory<T> mem{ 0 }; 
+
+    public:
+    /** @brief InterleavedWeights in a disengaged state */
+    InterleavedWeights() {} 
+    InterleavedWeights(unsigned neurons, unsigned dimensions, unsigned block) 
+        : mblock{ block }, 
+        mneurons{ neurons }, 
+        mdimensions{ dimensions }
+    {
+        Context context{ "InterleavedWeights::InterleavedWeights" };
+        self.mem = som::Memory<T>{ static_cast<std::size_t>( self.blocks() *self.block() ) *self.dimensions() }; 
+        std::fill( self.mem.get(), self.mem.get() + self.mem.size(), T{ 0 } ); 
+    }
+
+    getter(block, unsigned, (number of neurons of each block))
+    getter(neurons, unsigned, (number of neurons))
+    getter(dimensions, unsigned, (dimensions of the dataset))
+
+    unsigned blocks() const noexcept 
+    { return (self.neurons() + self.block() - 1) /self.block(); }
+
+    /** @brief The values of block b, dimension after dimension */
+    const T* block_entry(unsigned b) const noexcept 
+    { return self.mem.get() + b *self.block() *self.dimensions(); }
+
+    /** @brief Transposing view: the value of dimension d of neuron index */
+    T& at(unsigned index, unsigned d) noexcept 
+    { 
+        assert( index < self.neurons() ); 
+        assert( d < self.dimensions() ); 
+        return self.mem.get()[ (index /self.block()) *self.block() *self.dimensions() + d *self.block() + index %self.block() ]; 
+    }
+
+    /** @brief Copies (transposing) the values of weights */
+    template <class W>
+    void assign(const W& weights) noexcept 
+    {
+        assert( weights.size2() == self.neurons() ); 
+        const T* entry; 
+        for (unsigned index{ 0 }; index < self.neurons(); ++index) 
+        {
+            entry = weights.entry( index ); 
+            for (unsigned d{ 0 }; d < self.dimensions(); ++d) 
+                self.at( index, d ) = entry[ d ]; 
+        }
+    }
+}; // class InterleavedWeights
+
+
 /** @brief The numerator of the batch fraction has the same 
- *  dimensions and structure as the Weights 
+ *  dimensions and structure as the Weights, with values of type A 
  */
-using BatchNumerator = Weights<som::parallel::Memory<double>>; 
+template <class A=double>
+using BatchNumerator = Weights<som::parallel::Memory<A>>; 
 
-/** @brief Simple class representing the batch fraction */
+/** @brief Simple class representing the batch fraction, accumulated in A */
+template <class A=double>
 struct BatchFraction 
 {
-    BatchNumerator numerator{}; 
-    BatchNumerator numbuffer{}; 
-    som::parallel::Memory<double> denominator{ 1 }; 
-    som::parallel::Memory<double> denbuffer{ 1 };
+    BatchNumerator<A> numerator{}; 
+    BatchNumerator<A> numbuffer{}; 
+    som::parallel::Memory<A> denominator{}; 
+    som::parallel::Memory<A> denbuffer{};
+    /** the sum of the neighboring function for each neuron, 
+     *  kept only for sparse Datasets (see batch_fraction_sparse_complete()) 
+     */
+    som::parallel::Memory<A> nbsum{}; 
+    som::parallel::Memory<A> nbbuffer{}; 
 
     /** @brief BatchFraction in a disengaged state */
     BatchFraction() {} 
-    BatchFraction(unsigned rows, unsigned cols, unsigned dimensions) 
+    BatchFraction(unsigned rows, unsigned cols, unsigned dimensions, bool sparse=false) 
     {
         Context context{ "BatchFraction::BatchFraction" }; 
 
-        self.numerator = Weights<som::parallel::Memory<double>>{
+        self.numerator = BatchNumerator<A>{
             rows, cols, dimensions 
         };  
-        self.numbuffer = Weights<som::parallel::Memory<double>>{
+        self.numbuffer = BatchNumerator<A>{
             rows, cols, dimensions 
         };  
+        self.denominator = som::parallel::Memory<A>{ 1 }; 
+        self.denbuffer = som::parallel::Memory<A>{ 1 }; 
+
+        if ( sparse ) 
+        {
+            self.nbsum = som::parallel::Memory<A>{ rows *cols }; 
+            self.nbbuffer = som::parallel::Memory<A>{ rows *cols }; 
+        }
     }
 
     /** @brief Initializes the BatchFraction to 0 */
@@ -141,9 +249,12 @@ struct BatchFraction
         std::memset( 
             self.numerator.entry( 0 ), 
             0, 
-            self.numerator.size3() *sizeof(double)
+            self.numerator.size3() *sizeof(A)
         ); 
         self.denominator.get()[ 0 ] = 0; 
+
+        if ( self.nbsum.size() > 0 ) 
+            std::memset( self.nbsum.get(), 0, self.nbsum.bytes() ); 
     }
 
     /** @brief Sums the contribution to the batch fraction from all the 
@@ -162,19 +273,398 @@ struct BatchFraction
             self.denbuffer
         ); 
         self.denominator.swap( self.denbuffer ); 
+
+        if ( self.nbsum.size() > 0 ) 
+        {
+            self.nbsum.sum_all( self.nbbuffer ); 
+            self.nbsum.swap( self.nbbuffer ); 
+        }
     }
 }; // class BatchFraction
 
 
-/** @brief Simple class representing the state of the training process of the Lattice */
+/** @brief The strategies to find the best matching units (see TrainSettings::bmusearch()) */
+enum class BmuSearch 
+{
+    scan,   // all the neurons (with early abandon, see bmu_find())
+    bounds, // triangle-inequality bounds (see bmu_bounded_find())
+    window, // window around the previous BMU, approximate (see bmu_window_approximate_find()) 
+    tree,   // kd-tree over the weights (see WeightsTree) 
+    projection // shortlist in a random projection (see RandomProjection) 
+}; 
+
+
+/** @brief Simple class counting the BMUs found by an approximate search that are checked 
+ *  against the exact ones, and the ones that differ, since the last reset() (see bmu_checks_report()) 
+ */
+class BmuChecks 
+{
+    double mchecked{ 0 }; 
+    double mmismatched{ 0 }; 
+
+    public: 
+    getter(checked, double, (approximate BMUs checked against the exact ones since the last reset()))
+    getter(mismatched, double, (checked approximate BMUs that differ from the exact ones))
+
+    /** @brief Counts an approximate BMU checked against the exact one */
+    void check(unsigned approximate, unsigned exact) noexcept 
+    {
+        self.mchecked += 1; 
+        self.mmismatched += (approximate != exact)? 1 : 0; 
+    }
+
+    /** @brief Resets the counts */
+    void reset() noexcept 
+    {
+        self.mchecked = 0; 
+        self.mmismatched = 0; 
+    }
+}; // class BmuChecks
+
+
+/** @brief Simple class representing the per-record bounds used by bmu_bounded_find(). 
+ *  The upper bound of a record (on the distance from its BMU) grows with the drift of its BMU, 
+ *  the lower bound (on the distance from any other neuron) decreases with the largest drift: 
+ *  both are stored relative to the cumulative drifts, so that only the drifts need to be updated 
+ *  after each batch 
+ */
+struct BmuBounds 
+{
+    som::Memory<double> uppers{}; // upper bound - cumulative drift of the BMU, for each record 
+    som::Memory<double> lowers{}; // lower bound + cumulative largest drift, for each record 
+    som::Memory<double> cumdrifts{}; // cumulative drift of each neuron 
+    double cummax{ 0 }; // cumulative largest drift  
+
+    /** @brief BmuBounds in a disengaged state */
+    BmuBounds() {} 
+    BmuBounds(unsigned records, unsigned neurons) 
+        : 
+        uppers{ records }, 
+        lowers{ records }, 
+        cumdrifts{ neurons } 
+    {
+        Context context{ "BmuBounds::BmuBounds" }; 
+
+        // no bounds are known before the first scan 
+        std::fill( self.uppers.get(), self.uppers.get() + records, std::numeric_limits<double>::infinity() ); 
+        std::fill( self.lowers.get(), self.lowers.get() + records, 0.0 ); 
+        std::fill( self.cumdrifts.get(), self.cumdrifts.get() + neurons, 0.0 ); 
+    }
+}; // struct BmuBounds
+
+
+/** @brief Simple class reserving som::arena() (bytes) and som::parallel::arena() (pbytes) 
+ *  while it is alive, so that the buffers of the training process are handed out 
+ *  by the arenas instead of being allocated one by one. 
+ *  Throws std::bad_alloc if either cannot be reserved, leaving both empty 
+ */
+struct ArenaReservation 
+{
+    ArenaReservation(std::size_t bytes, std::size_t pbytes) 
+    {
+        Context context{ "ArenaReservation::ArenaReservation" }; 
+
+        som::arena().reserve( bytes ); 
+        try 
+        {
+            som::parallel::arena().reserve( pbytes ); 
+        }
+        catch (...) 
+        {
+            som::arena().clear(); 
+            throw; 
+        }
+    }
+
+    ~ArenaReservation() noexcept 
+    {
+        Context context{ "ArenaReservation::~ArenaReservation" }; 
+
+        som::arena().clear(); 
+        som::parallel::arena().clear(); 
+    }
+
+    ArenaReservation(const ArenaReservation&) = delete; 
+    ArenaReservation& operator = (const ArenaReservation&) = delete; 
+}; // struct ArenaReservation
+
+
+/** @brief The phases of the training process timed separately (see PhaseTimers) */
+enum class Phase 
+{
+    load,       // reading the Dataset 
+    init,       // random initialization of the weights 
+    search,     // BMU searches (including the per-batch preparation of the engines) 
+    accumulate, // accumulation of the batch fraction 
+    reduce,     // reduction of the batch fraction accross the ranks 
+    commit,     // update of the weights (and of the bounds) 
+    epcall,     // TrainSettings::epcall() 
+    print,      // printing of the Lattice 
+    count 
+}; 
+
+/** @brief Simple class representing one Timer for each Phase of the training process and, 
+ *  if enabled (see counting()), the hardware performance counters (see PerfCounters) of each Phase 
+ */
+class PhaseTimers 
+{
+    static constexpr unsigned count{ static_cast<unsigned>( Phase::count ) }; 
+    static_assert( count <= som::parallel::State::scratch_count ); 
+
+    som::parallel::Timer<std::chrono::nanoseconds> timers[ count ]{}; 
+    PerfCounters counters{}; 
+    std::uint64_t mcounts[ count ][ PerfCounters::count ]{}; // counted in each Phase 
+    std::uint64_t mstarts[ PerfCounters::count ]{}; // read by the last start() 
+
+    public: 
+    /** @brief Returns the name of phase */
+    static const char* name(Phase phase) noexcept 
+    {
+        constexpr const char* names[ count ]{ 
+            "load", "init", "search", "accumulate", "reduce", "commit", "epcall", "print" 
+        }; 
+        return names[ static_cast<unsigned>(phase) ]; 
+    }
+
+    /** @brief Starts counting the hardware performance counters of each Phase too, 
+     *  fpevent is the raw event of the floating point operations (0 not to count them, 
+     *  see PerfCounters::open()). Returns false if they are not available 
+     */
+    bool counting(std::uint64_t fpevent) noexcept 
+    { return self.counters.open( fpevent ); }
+
+    /** @brief Starts the Timer (and the counters) of phase */
+    void start(Phase phase) noexcept 
+    { 
+        if ( self.counters.enabled() ) 
+            self.counters.read( self.mstarts ); 
+        self.timers[ static_cast<unsigned>(phase) ].start(); 
+    }
+
+    /** @brief Stops the Timer (and the counters) of phase */
+    void stop(Phase phase) noexcept 
+    { 
+        self.timers[ static_cast<unsigned>(phase) ].stop(); 
+        if ( self.counters.enabled() ) 
+        {
+            std::uint64_t values[ PerfCounters::count ]; 
+            self.counters.read( values ); 
+            for (unsigned counter{ 0 }; counter < PerfCounters::count; ++counter) 
+                self.mcounts[ static_cast<unsigned>(phase) ][ counter ] += values[ counter ] - self.mstarts[ counter ]; 
+        }
+    }
+
+    /** @brief Returns the time spent (so far) in phase on the current rank (nanoseconds) */
+    std::uint64_t total(Phase phase) const noexcept 
+    { return self.timers[ static_cast<unsigned>(phase) ].total(); }
+
+    /** @brief Prints the min, mean and max time of each phase accross all ranks (microseconds) 
+     *  and, if enabled, the counters of each phase of the current rank with the derived 
+     *  instructions per cycle and bytes (last level cache misses, of 64 bytes) per floating point 
+     *  operation. All ranks must call it 
+     */
+    void report() const noexcept 
+    {
+        double sums[ count ], maxs[ count ], negmins[ count ]; 
+        for (unsigned idx{ 0 }; idx < count; ++idx) 
+        {
+            sums[ idx ] = maxs[ idx ] = static_cast<double>( self.timers[ idx ].total() ) /1e3; 
+            negmins[ idx ] = -sums[ idx ]; 
+        }
+        som::parallel::sum_all( sums, count ); 
+        som::parallel::max_all( maxs, count ); 
+        som::parallel::max_all( negmins, count ); 
+
+        for (unsigned idx{ 0 }; idx < count; ++idx) 
+            myprint::outln( 
+                "phase", name( static_cast<Phase>(idx) ), 
+                "min", -negmins[ idx ], 
+                "mean", sums[ idx ] /som::parallel::ranks(), 
+                "max", maxs[ idx ], 
+                "(microseconds)" 
+            ); 
+
+        if ( not self.counters.enabled() ) 
+            return; 
+        for (unsigned idx{ 0 }; idx < count; ++idx) 
+        {
+            const std::uint64_t* counts{ self.mcounts[ idx ] }; 
+            const double ipc{ static_cast<double>( counts[ PerfCounters::instructions ] ) /
+                std::max( counts[ PerfCounters::cycles ], std::uint64_t{ 1 } ) }; 
+            myprint::outln( 
+                "rank", som::parallel::rank(), 
+                "phase", name( static_cast<Phase>(idx) ), 
+                "cycles", counts[ PerfCounters::cycles ], 
+                "instructions", counts[ PerfCounters::instructions ], 
+                "ipc", ipc, 
+                "llcmisses", counts[ PerfCounters::llcmisses ] 
+            ); 
+            if ( self.counters.fpcounted() ) 
+                myprint::outln( 
+                    "rank", som::parallel::rank(), 
+                    "phase", name( static_cast<Phase>(idx) ), 
+                    "fpops", counts[ PerfCounters::fpops ], 
+                    "bytesperflop", static_cast<double>( 64 *counts[ PerfCounters::llcmisses ] ) /
+                        std::max( counts[ PerfCounters::fpops ], std::uint64_t{ 1 } ) 
+                ); 
+        }
+    }
+}; // class PhaseTimers 
+
+
+/** @brief Simple class representing the stream of the per-epoch metrics (see TrainSettings::metrics()): 
+ *  one JSON object per line, with the values of the master rank only, so that no communication 
+ *  is needed. The lines are buffered and written to the file at most once per flush_interval 
+ *  (or when the buffer exceeds flush_bytes), and at destruction 
+ */
+class MetricsStream 
+{
+    static constexpr std::uint64_t flush_interval{ 1000000000 }; // nanoseconds 
+    static constexpr std::size_t flush_bytes{ 1 << 16 }; 
+    static constexpr unsigned count{ static_cast<unsigned>( Phase::count ) }; 
+
+    std::ofstream mfile{}; 
+    std::string mbuffer{}; 
+    std::uint64_t mflushed{ 0 }; // time of the last flush() 
+    std::uint64_t mstart{ 0 }; // time of the last begin() 
+    std::uint64_t mcommunicated{ 0 }; // bytes communicated at the last begin() 
+    std::uint64_t mphases[ count ]{}; // time spent in each Phase at the last begin() 
+
+    /** @brief Appends value to the buffer, null if it is not finite (as JSON does not allow it) */
+    void append(double value) 
+    {
+        if ( not std::isfinite( value ) ) 
+        {
+            self.mbuffer += "null"; 
+            return; 
+        }
+        std::ostringstream ostream{}; 
+        ostream << std::setprecision( 10 ) << value; 
+        self.mbuffer += ostream.str(); 
+    }
+
+    public: 
+    /** @brief Constructs a MetricsStream writing to fname on the master rank 
+     *  (disabled on the other ones, or if fname is empty) 
+     */
+    MetricsStream(const std::string& fname) 
+    {
+        if ( som::parallel::rank() > 0 or fname.empty() ) 
+            return; 
+        self.mfile.open( fname, std::ios::trunc ); 
+        if ( not self.mfile.is_open() ) 
+            throw std::runtime_error{ "could not open metrics " + fname }; 
+        self.mbuffer.reserve( flush_bytes ); 
+        self.mflushed = som::parallel::Timer<std::chrono::nanoseconds>::now(); 
+    }
+
+    MetricsStream(const MetricsStream&) = delete; 
+    MetricsStream& operator = (const MetricsStream&) = delete; 
+
+    ~MetricsStream() noexcept { self.flush(); } 
+
+    /** @brief Returns whether the metrics are written by the current rank */
+    bool enabled() const noexcept { return self.mfile.is_open(); }
+
+    /** @brief Marks the begin of an epoch */
+    void begin(const PhaseTimers& phases) noexcept 
+    {
+        if ( not self.enabled() ) 
+            return; 
+        for (unsigned idx{ 0 }; idx < count; ++idx) 
+            self.mphases[ idx ] = phases.total( static_cast<Phase>(idx) ); 
+        self.mcommunicated = som::parallel::communicated(); 
+        self.mstart = som::parallel::Timer<std::chrono::nanoseconds>::now(); 
+    }
+
+    /** @brief Appends the metrics of the epoch begun by the last begin(), in which records records 
+     *  were presented (over all ranks), the time of each Phase is in microseconds 
+     */
+    void end(unsigned epoch, double diff, double nradius, std::size_t records, const PhaseTimers& phases) 
+    {
+        if ( not self.enabled() ) 
+            return; 
+        const std::uint64_t now{ som::parallel::Timer<std::chrono::nanoseconds>::now() }; 
+        const double seconds{ static_cast<double>( now - self.mstart ) /1e9 }; 
+
+        self.mbuffer += "{\"epoch\":" + std::to_string( epoch ) + ",\"diff\":"; 
+        self.append( diff ); 
+        self.mbuffer += ",\"nradius\":"; 
+        self.append( nradius ); 
+        self.mbuffer += ",\"phases\":{"; 
+        for (unsigned idx{ 0 }; idx < count; ++idx) 
+        {
+            self.mbuffer += (idx > 0)? ",\"" : "\""; 
+            self.mbuffer += PhaseTimers::name( static_cast<Phase>(idx) ); 
+            self.mbuffer += "\":"; 
+            self.append( static_cast<double>( phases.total( static_cast<Phase>(idx) ) - self.mphases[ idx ] ) /1e3 ); 
+        }
+        self.mbuffer += "},\"communicated\":" + std::to_string( som::parallel::communicated() - self.mcommunicated ); 
+        self.mbuffer += ",\"recordspersec\":"; 
+        self.append( (seconds > 0)? static_cast<double>( records ) /seconds : 0.0 ); 
+        self.mbuffer += "}\n"; 
+
+        if ( self.mbuffer.size() >= flush_bytes or now - self.mflushed >= flush_interval ) 
+            self.flush(); 
+    }
+
+    /** @brief Writes the buffered lines to the file */
+    void flush() noexcept 
+    {
+        if ( not self.enabled() or self.mbuffer.empty() ) 
+            return; 
+        self.mfile.write( self.mbuffer.data(), self.mbuffer.size() ); 
+        self.mfile.flush(); 
+        self.mbuffer.clear(); 
+        self.mflushed = som::parallel::Timer<std::chrono::nanoseconds>::now(); 
+    }
+}; // class MetricsStream 
+
+
+/** @brief Simple class representing the part of the state of the training process 
+ *  that does not depend on the Precision, i.e., the one the Lattice has access to 
+ */
 struct TrainState 
 {
+    unsigned epoch{ 0 }; 
+    unsigned batch{ 0 }; 
+    double nradius{ 0 }; 
+    double diff{ 1 }; 
+    som::parallel::Timer<std::chrono::microseconds> total{}; 
+    PhaseTimers phases{}; 
+    const PrintFormat printformat{ PrintFormat::text }; 
+
+    TrainState(const TrainSettings& settings) 
+        : printformat{ print_format( settings.printformat() ) } 
+    {}
+
+    virtual ~TrainState() noexcept {}
+
+    /** @brief Prints the Weights to fname in printformat */
+    virtual void print(const std::string& fname) const = 0; 
+}; // struct TrainState 
+
+
+/** @brief Simple class representing the state of the training process of the Lattice 
+ *  for the given Precision P, the given Dataset storage D and the given metric M (see metrics.hpp) 
+ */
+template <
+    class P=DoublePrecision, 
+    class D=Dataset<typename P::value_type>, 
+    class M=Euclidean<typename P::value_type>
+>
+struct TrainState_ : public TrainState 
+{
+    using T = typename P::value_type; 
+    using A = typename P::accumulator_type; 
+    static_assert( std::is_same<T, typename D::value_type>::value ); 
+
     /** @brief Constant parameters set at the begining of the training process */
     struct Constants
     {
         unsigned rank{ 0 };
         unsigned ranks{ 1 }; 
-        Dataset dataset{}; 
+        D dataset{}; 
         unsigned rrecords{ 0 }; 
         unsigned epochs{ 0 }; 
         double diffmin{ 0 };
@@ -185,45 +675,120 @@ struct TrainState
         double rdecay{ 1e-1 }; 
         unsigned rseed{ 0 }; 
         double valmean{ 1 }; 
+        BmuSearch bmusearch{ BmuSearch::scan }; 
+        unsigned bmuwindow{ 2 }; 
+        unsigned bmurescan{ 10 }; 
+        unsigned bmusketch{ 16 }; 
+        double bmurecall{ 0.05 }; 
+        unsigned wblock{ 0 }; // neurons per block of the InterleavedWeights, 0 if not used 
+        unsigned printqueue{ 0 }; // snapshots in flight with printmode async (see SnapshotWriter), 0 with sync 
         
-        /** @brief Initialize the constant parameters given TrainSettings */
-        Constants(const Lattice& lattice, const TrainSettings& training); 
+        /** @brief Initialize the constant parameters given TrainSettings, 
+         *  timing the reading of the Dataset with phases (whose counters are started here) 
+         */
+        Constants(const Lattice& lattice, const TrainSettings& training, PhaseTimers& phases); 
     }; // struct Constants
 
     const Constants constants;
     
+    /** the metric used to find the best matching units */
+    M metric; 
+
+    /** the arenas of the buffers below (declared before them, they are released after them) */
+    const ArenaReservation arenas; 
+
 
     /** the state (weights) of the Lattice */
-    Weights<som::Memory<double>> weights{};
+    Weights<som::Memory<T>> weights{};
 
     /** the batch fraction */
-    BatchFraction bfraction{}; 
+    BatchFraction<A> bfraction{}; 
 
-    unsigned epoch{ 0 }; 
-    unsigned batch{ 0 }; 
-    double nradius{ 0 }; 
-    double diff{ 1 }; 
-    som::parallel::Timer<std::chrono::microseconds> total{}; 
+    /** the squared norm of the weights of each neuron, 
+     *  kept only for sparse Datasets (see weights_sqnorms()) 
+     */
+    som::Memory<T> sqnorms{}; 
 
-    TrainState(const Lattice& lattice, const TrainSettings& settings); 
-}; // struct TrainState 
+    /** the thresholded weights of each neuron packed in bits (as the records), 
+     *  kept only for binary Datasets (see weights_threshold()) 
+     */
+    som::Memory<std::uint64_t> wbits{}; 
+
+    /** the BMU (index) of each record of the current batch, found before the accumulation */
+    som::Memory<unsigned> bbmus{}; 
+
+    /** the BMU (index) of each record of the rank in the previous batch, 
+     *  tried first by bmu_find(), kept only for dense and quantized Datasets 
+     */
+    som::Memory<unsigned> bmus{}; 
+
+    /** the bounds of each record, kept only when bmusearch is BmuSearch::bounds */
+    BmuBounds bounds{}; 
 
+    /** the BMUs of bmusearch window or projection checked against the exact ones */
+    BmuChecks checks{}; 
 
-TrainState::Constants::Constants(const Lattice& lattice, const TrainSettings& settings) 
+    /** the kd-tree over the weights, kept only when bmusearch is BmuSearch::tree */
+    WeightsTree tree{}; 
+
+    /** the random projection, kept only when bmusearch is BmuSearch::projection */
+    RandomProjection<T> projection{}; 
+
+    /** the weights in the neuron-interleaved layout, kept only when wblock > 0 */
+    InterleavedWeights<T> iweights{}; 
+
+    /** the writer of the snapshots of the weights printed by the master rank, 
+     *  started only when printqueue > 0 (it is mutable as print() is const) 
+     */
+    mutable SnapshotWriter<T> snapshots{}; 
+
+    TrainState_(const Lattice& lattice, const TrainSettings& settings); 
+
+    void print(const std::string& fname) const override; 
+
+    private: 
+    /** @brief Reserves the arenas for the buffers allocated by the constructor and by the training process */
+    ArenaReservation reservation(const Lattice& lattice) const; 
+}; // struct TrainState_ 
+
+
+template <class P, class D, class M>
+TrainState_<P, D, M>::Constants::Constants(
+    const Lattice& lattice, const TrainSettings& settings, PhaseTimers& phases
+) 
 {
     Context context{ "TrainState::Constants::Constants" }; 
 
     self.rank = lattice.rank();
     self.ranks = lattice.ranks(); 
 
-    self.dataset = som::Dataset{ 
-        settings.dataset(), settings.batchsize()
-    }; 
-
+    if ( settings.counters() == "hardware" ) 
+    {
+        if ( not phases.counting( std::stoull( settings.fpevent(), nullptr, 0 ) ) ) 
+            myprint::errln( "rank", self.rank, "hardware performance counters are not available" ); 
+    }
+    else if ( settings.counters() != "none" ) 
+        throw std::invalid_argument{ 
+            "counters '" + settings.counters() + "' is not one of none or hardware" 
+        }; 
+
+    phases.start( Phase::load ); 
+    const MemoryScope scope{ MemoryCategory::dataset }; 
+
+    if constexpr ( M::normalized ) 
+        self.dataset = D{ 
+            settings.dataset(), settings.batchsize(), true 
+        }; 
+    else 
+        self.dataset = D{ 
+            settings.dataset(), settings.batchsize()
+        }; 
+
+    phases.stop( Phase::load ); 
     self.rrecords = dataset.rrecords(); 
     
     self.epochs = (settings.epochs() > 0)? 
-        settings.epochs() : dataset.trecords();
+        settings.epochs() : static_cast<unsigned>( dataset.trecords() ); // at most UINT_MAX (see DatasetLayout::read_lines()) 
 
     self.diffmin = (settings.diffmin() > 1e-6)?
         settings.diffmin() : 0; 
@@ -241,25 +806,178 @@ TrainState::Constants::Constants(const Lattice& lattice, const TrainSettings& se
     self.rseed = settings.rseed(); 
 
     self.valmean = dataset.valmean();
+
+    if ( settings.bmusearch() == "scan" ) 
+        self.bmusearch = BmuSearch::scan; 
+    else if ( settings.bmusearch() == "bounds" ) 
+        self.bmusearch = BmuSearch::bounds; 
+    else if ( settings.bmusearch() == "window" ) 
+        self.bmusearch = BmuSearch::window; 
+    else if ( settings.bmusearch() == "tree" ) 
+        self.bmusearch = BmuSearch::tree; 
+    else if ( settings.bmusearch() == "projection" ) 
+        self.bmusearch = BmuSearch::projection; 
+    else 
+        throw std::invalid_argument{ 
+            "bmusearch '" + settings.bmusearch() + "' is not one of scan, bounds, window, tree or projection" 
+        }; 
+
+    if ( (self.bmusearch != BmuSearch::scan and (D::sparse or D::binary)) or 
+         (self.bmusearch == BmuSearch::bounds and not M::triangle) or 
+         (self.bmusearch == BmuSearch::tree and not M::separable) ) 
+        throw std::invalid_argument{ 
+            "bmusearch '" + settings.bmusearch() + "' is not supported with storage '" + 
+            settings.storage() + "' and metric '" + settings.metric() + "'" 
+        }; 
+    self.bmuwindow = settings.bmuwindow(); 
+    self.bmurescan = settings.bmurescan(); 
+    self.bmusketch = std::max( 1u, settings.bmusketch() ); 
+    self.bmurecall = settings.bmurecall(); 
+
+    if ( settings.layout() == "interleaved8" ) 
+        self.wblock = 8; 
+    else if ( settings.layout() == "interleaved16" ) 
+        self.wblock = 16; 
+    else if ( settings.layout() != "neurons" ) 
+        throw std::invalid_argument{ 
+            "layout '" + settings.layout() + "' is not one of neurons, interleaved8 or interleaved16" 
+        }; 
+
+    if ( self.wblock > 0 and (self.bmusearch != BmuSearch::scan or D::sparse or D::binary or not M::separable) ) 
+        throw std::invalid_argument{ 
+            "layout '" + settings.layout() + "' is not supported with bmusearch '" + settings.bmusearch() + 
+            "', storage '" + settings.storage() + "' and metric '" + settings.metric() + "'" 
+        }; 
+
+    if ( settings.printmode() == "async" ) 
+        self.printqueue = std::max( 1u, settings.printqueue() ); 
+    else if ( settings.printmode() != "sync" ) 
+        throw std::invalid_argument{ 
+            "printmode '" + settings.printmode() + "' is not one of sync or async" 
+        }; 
 }
         
-TrainState::TrainState(const Lattice& lattice, const TrainSettings& settings)
+template <class P, class D, class M>
+TrainState_<P, D, M>::TrainState_(const Lattice& lattice, const TrainSettings& settings)
     : 
-    constants{ lattice, settings }
+    TrainState{ settings }, 
+    constants{ lattice, settings, self.phases }, 
+    metric{ constants.dataset, lattice.rows() *lattice.cols() }, 
+    arenas{ self.reservation( lattice ) }
 {   
     Context context{ "TrainState::TrainState" }; 
 
-    self.weights = Weights<som::Memory<double>>{ 
-        lattice.rows(), lattice.cols(), constants.dataset.dimensions() 
-    };     
-    self.bfraction = BatchFraction{ 
-        lattice.rows(), lattice.cols(), constants.dataset.dimensions()
-    }; 
+    {
+        const MemoryScope scope{ MemoryCategory::weights }; 
+        self.weights = Weights<som::Memory<T>>{ 
+            lattice.rows(), lattice.cols(), constants.dataset.dimensions() 
+        };     
+        if ( D::sparse ) 
+            self.sqnorms = som::Memory<T>{ lattice.rows() *lattice.cols() }; 
+        if ( D::binary ) 
+            self.wbits = som::Memory<std::uint64_t>{ 
+                lattice.rows() *lattice.cols() *((constants.dataset.dimensions() + 63) /64) 
+            }; 
+        if ( constants.wblock > 0 ) 
+            self.iweights = InterleavedWeights<T>{ 
+                lattice.rows() *lattice.cols(), constants.dataset.dimensions(), constants.wblock 
+            }; 
+    }
+    {
+        const MemoryScope scope{ MemoryCategory::bfraction }; 
+        self.bfraction = BatchFraction<A>{ 
+            lattice.rows(), lattice.cols(), constants.dataset.dimensions(), D::sparse 
+        }; 
+    }
+    {
+        const MemoryScope scope{ MemoryCategory::scratch }; 
+        self.bbmus = som::Memory<unsigned>{ constants.rbatchsize }; 
+        if ( not D::sparse and not D::binary ) 
+        {
+            self.bmus = som::Memory<unsigned>{ constants.rrecords }; 
+            std::fill( self.bmus.get(), self.bmus.get() + self.bmus.size(), 0 ); 
+        }
+        if ( constants.bmusearch == BmuSearch::bounds ) 
+            self.bounds = BmuBounds{ constants.rrecords, lattice.rows() *lattice.cols() }; 
+        if ( constants.bmusearch == BmuSearch::tree ) 
+            self.tree = WeightsTree{ lattice.rows() *lattice.cols() }; 
+        if constexpr ( not D::sparse and not D::binary ) 
+            if ( constants.bmusearch == BmuSearch::projection ) 
+                self.projection = RandomProjection<T>{ 
+                    constants.dataset, lattice.rows() *lattice.cols(), constants.bmusketch, constants.bmurecall 
+                }; 
+    }
+    // only the master rank prints the Lattice 
+    if ( constants.printqueue > 0 and constants.rank == 0 ) 
+        self.snapshots.start( constants.printqueue ); 
 
     self.epoch = 0; 
     self.batch = 0; 
     self.nradius = self.constants.nradius; 
     self.diff = 1; 
+
+    context.results( 
+        "arena", som::arena().used(), "of", som::arena().capacity(), 
+        "parallel arena", som::parallel::arena().used(), "of", som::parallel::arena().capacity() 
+    ); 
+}
+
+template <class P, class D, class M>
+ArenaReservation 
+TrainState_<P, D, M>::reservation(const Lattice& lattice) const 
+{
+    const std::size_t neurons{ lattice.rows() *lattice.cols() }; 
+    const std::size_t dimensions{ self.constants.dataset.dimensions() }; 
+    const std::size_t records{ self.constants.rrecords }; 
+    const auto block = [](std::size_t count, std::size_t size) { return Arena::footprint( count *size ); }; 
+
+    std::size_t bytes{ block( neurons *dimensions, sizeof(T) ) }; // the weights 
+    bytes += block( self.constants.rbatchsize, sizeof(unsigned) ); 
+    if ( D::sparse ) 
+        bytes += block( neurons, sizeof(T) ); 
+    if ( D::binary ) 
+        bytes += block( neurons *((dimensions + 63) /64), sizeof(std::uint64_t) ); 
+    if ( not D::sparse and not D::binary ) 
+        bytes += block( records, sizeof(unsigned) ); 
+    if ( self.constants.bmusearch == BmuSearch::bounds ) 
+        bytes += 2 *block( records, sizeof(double) ) + block( neurons, sizeof(double) ); 
+    if ( self.constants.bmusearch == BmuSearch::tree ) 
+        bytes += 2 *block( neurons, sizeof(unsigned) ); 
+    if ( self.constants.wblock > 0 ) 
+        bytes += block( (neurons + self.constants.wblock - 1) /self.constants.wblock *self.constants.wblock *dimensions, sizeof(T) ); 
+    if ( self.constants.printqueue > 0 and self.constants.rank == 0 ) 
+        bytes += self.constants.printqueue *block( neurons *dimensions, sizeof(T) ); // the snapshots 
+    if ( not D::sparse and not D::binary and self.constants.bmusearch == BmuSearch::projection ) 
+    {
+        const std::size_t sketch{ self.constants.bmusketch }; 
+        bytes += block( sketch *dimensions, sizeof(T) ) + block( sketch *records, sizeof(T) ) + 
+            block( sketch *neurons, sizeof(T) ) + block( neurons, sizeof(T) ) + block( neurons, sizeof(unsigned) ); 
+    }
+
+    // the batch fraction and the buffer of weights_random_init() 
+    std::size_t pbytes{ 2 *block( neurons *dimensions, sizeof(A) ) + 2 *block( 1, sizeof(A) ) }; 
+    if ( D::sparse ) 
+        pbytes += 2 *block( neurons, sizeof(A) ); 
+    pbytes += block( dimensions, sizeof(T) ); 
+
+    return ArenaReservation{ bytes, pbytes }; 
+}
+
+template <class P, class D, class M>
+void 
+TrainState_<P, D, M>::print(const std::string& fname) const 
+{
+    WeightsHeader header{}; 
+    header.rows = self.weights.rows(); 
+    header.cols = self.weights.cols(); 
+    header.dimensions = self.weights.dimensions(); 
+    header.valuesize = sizeof(T); 
+    header.epoch = self.epoch; 
+
+    if ( self.snapshots.enabled() ) 
+        self.snapshots.write( fname, self.printformat, header, self.weights.entry( 0 ) ); 
+    else 
+        weights_write( fname, self.printformat, header, self.weights.entry( 0 ) ); 
 }
 } // namespace som
 #endif // SOM_TRAINSTATE_HPP_GUARD
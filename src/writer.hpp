@@ -0,0 +1,372 @@
+// DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+// 
+// Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+// You may use, distribute and modify this code under the
+// terms of the BSD 4-clause license. 
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT 
+//  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+// FITNESS FOR A PARTICULAR PURPOSE. 
+//
+// You should have received a copy of the BSD 4-clause license along 
+// with DIAPASOM; see the file LICENSE. If not see 
+// <https://en.wikipedia.org/wiki/BSD_licenses>.
+//
+//
+// Authors: 
+//     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+//     Matteo Poggi <matteo.poggi@exact-lab.it>
+//     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+//
+
+
+#ifndef SOM_WRITER_HPP_GUARD
+#define SOM_WRITER_HPP_GUARD
+
+
+#include "common.hpp"
+#include "memory.hpp"
+
+#include <charconv>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+
+
+#define self (*this)
+
+
+namespace som
+{
+
+/** @brief The formats of the Lattice printed by Lattice::print() (see TrainSettings::printformat()) */
+enum class PrintFormat 
+{
+    text,   // one neuron per line (see TextWriter) 
+    binary  // WeightsHeader followed by the raw weights 
+}; 
+
+/** @brief Returns the PrintFormat named name (text or binary) */
+static inline 
+PrintFormat 
+print_format(const std::string& name) 
+{
+    if ( name == "text" ) 
+        return PrintFormat::text; 
+    if ( name == "binary" ) 
+        return PrintFormat::binary; 
+    throw std::invalid_argument{ 
+        "printformat '" + name + "' is not one of text or binary" 
+    }; 
+}
+
+
+/** @brief Simple class representing a buffered text writer: the values are formatted 
+ *  with std::to_chars (as operator<< would with the default flags and precision) 
+ *  into a buffer, that is written to the file only when full and by close(). 
+ *  The write errors throw std::runtime_error, the characters not written 
+ *  by close() are discarded at destruction 
+ */
+class TextWriter 
+{
+    static constexpr std::size_t capacity{ 1 << 20 }; 
+    static constexpr std::size_t longest{ 64 }; // the longest value formatted 
+
+    std::string mfname{}; 
+    std::ofstream mfile{}; 
+    std::unique_ptr<char[]> mbuffer{ new char[ capacity ] }; 
+    std::size_t mused{ 0 }; 
+
+    /** @brief Returns where the next value can be formatted, with room for the longest one */
+    char* room() 
+    {
+        if ( self.mused + longest > capacity ) 
+            self.flush(); 
+        return self.mbuffer.get() + self.mused; 
+    }
+
+    public: 
+    /** @brief Constructs a TextWriter writing to fname, throws std::runtime_error if it cannot */
+    explicit TextWriter(const std::string& fname) 
+        : mfname{ fname }, 
+        mfile{ fname, std::ios::trunc | std::ios::binary } 
+    {
+        if ( not self.mfile.is_open() ) 
+            throw std::runtime_error{ "could not write " + fname }; 
+    }
+
+    TextWriter(const TextWriter&) = delete; 
+    TextWriter& operator = (const TextWriter&) = delete; 
+
+    /** @brief Writes the character c */
+    TextWriter& write(char c) 
+    {
+        *self.room() = c; 
+        ++self.mused; 
+        return self; 
+    }
+
+    /** @brief Writes value, an integer or a floating point value (%g with precision 6) */
+    template <class T>
+    TextWriter& write(T value) 
+    {
+        char* first{ self.room() }; 
+        std::to_chars_result result; 
+        if constexpr ( std::is_floating_point<T>::value ) 
+            result = std::to_chars( first, first + longest, value, std::chars_format::general, 6 ); 
+        else 
+            result = std::to_chars( first, first + longest, value ); 
+        assert( result.ec == std::errc{} ); 
+        self.mused += static_cast<std::size_t>( result.ptr - first ); 
+        return self; 
+    }
+
+    /** @brief Writes the buffered characters to the file, throws std::runtime_error if it cannot */
+    void flush() 
+    {
+        if ( self.mused == 0 ) 
+            return; 
+        self.mfile.write( self.mbuffer.get(), static_cast<std::streamsize>( self.mused ) ); 
+        self.mfile.flush(); 
+        self.mused = 0; 
+        if ( not self.mfile ) 
+            throw std::runtime_error{ "could not write " + self.mfname }; 
+    }
+
+    /** @brief Writes the buffered characters and closes the file, throws std::runtime_error if it cannot */
+    void close() 
+    {
+        self.flush(); 
+        self.mfile.close(); 
+        if ( not self.mfile ) 
+            throw std::runtime_error{ "could not close " + self.mfname }; 
+    }
+}; // class TextWriter
+
+
+/** @brief The header of the binary format of the Weights (see PrintFormat::binary): it is followed by 
+ *  rows *cols *dimensions values of valuesize bytes, in the byte order of the host, with the dimensions 
+ *  values of each neuron contiguous and the neurons in row-major order 
+ */
+struct WeightsHeader 
+{
+    char magic[ 8 ]{ 'D', 'I', 'A', 'P', 'A', 'S', 'O', 'M' }; 
+    std::uint32_t version{ 1 }; 
+    std::uint32_t rows{ 0 }; 
+    std::uint32_t cols{ 0 }; 
+    std::uint32_t dimensions{ 0 }; 
+    std::uint32_t valuesize{ 0 }; // 4 (float) or 8 (double) 
+    std::uint32_t epoch{ 0 }; 
+}; // struct WeightsHeader
+static_assert( sizeof(WeightsHeader) == 32 ); 
+
+
+/** @brief Writes the WeightsHeader header and the count values at values to fname, 
+ *  throws std::runtime_error if it cannot 
+ */
+template <class T>
+static inline 
+void 
+weights_write_binary(const std::string& fname, const WeightsHeader& header, const T* values, std::size_t count) 
+{
+    assert( header.valuesize == sizeof(T) ); 
+    std::ofstream ofile{ fname, std::ios::trunc | std::ios::binary }; 
+    if ( not ofile.is_open() ) 
+        throw std::runtime_error{ "could not write " + fname }; 
+    ofile.write( reinterpret_cast<const char*>( &header ), sizeof(header) ); 
+    ofile.write( reinterpret_cast<const char*>( values ), static_cast<std::streamsize>( count *sizeof(T) ) ); 
+    ofile.close(); 
+    if ( not ofile ) 
+        throw std::runtime_error{ "could not write " + fname }; 
+}
+
+
+/** @brief Writes the Weights described by header, with values at values, to fname in text format: 
+ *  one neuron per line, "row col  value  value  ...". Throws std::runtime_error if it cannot 
+ */
+template <class T>
+static inline 
+void 
+weights_write_text(const std::string& fname, const WeightsHeader& header, const T* values) 
+{
+    TextWriter writer{ fname }; 
+    for (unsigned row{ 0 }; row < header.rows; ++row) 
+        for (unsigned col{ 0 }; col < header.cols; ++col)
+        {
+            writer.write( row ).write( ' ' ).write( col ).write( ' ' ).write( ' ' ); 
+            for (unsigned d{ 0 }; d < header.dimensions; ++d, ++values)
+                writer.write( *values ).write( ' ' ).write( ' ' ); 
+            writer.write( '\n' ); 
+        }
+    writer.close(); 
+}
+
+/** @brief Writes the Weights described by header, with values at values, to fname in format. 
+ *  Throws std::runtime_error if it cannot 
+ */
+template <class T>
+static inline 
+void 
+weights_write(const std::string& fname, PrintFormat format, const WeightsHeader& header, const T* values) 
+{
+    if ( format == PrintFormat::binary ) 
+        weights_write_binary( 
+            fname, header, values, static_cast<std::size_t>( header.rows ) *header.cols *header.dimensions 
+        ); 
+    else 
+        weights_write_text( fname, header, values ); 
+}
+
+
+/** @brief Simple class representing a writer of snapshots of the Weights on a background thread, 
+ *  so that the training goes on while they are formatted and written: write() copies the values 
+ *  into one of at most capacity buffers, waiting for one to be free (so that the memory used is bounded), 
+ *  and returns at once, the thread writes the snapshots in order. The buffers are allocated (in the 
+ *  MemoryCategory snapshots) by the calling thread on first use and reused, the background thread 
+ *  never allocates from som::malloc() nor uses Context. The errors of the background thread (opening, 
+ *  writing or closing the files, see weights_write()) are rethrown by the next write() or flush() 
+ */
+template <class T>
+class SnapshotWriter 
+{
+    struct Snapshot 
+    {
+        std::string fname{}; 
+        PrintFormat format{ PrintFormat::text }; 
+        WeightsHeader header{}; 
+        som::Memory<T>* buffer{ nullptr }; 
+    }; 
+
+    unsigned mcapacity{ 0 }; 
+    std::vector<som::Memory<T>> mbuffers{}; // allocated so far, never more than mcapacity 
+    std::vector<som::Memory<T>*> mfree{}; // the buffers not in flight 
+    std::deque<Snapshot> mqueue{}; // the snapshots to write 
+    unsigned minflight{ 0 }; // the buffers taken by write() and not written yet 
+    bool mstop{ false }; 
+    std::exception_ptr merror{}; 
+    std::mutex mmutex{}; 
+    std::condition_variable mready{}; // signals the background thread 
+    std::condition_variable mdone{}; // signals the waiting write() and flush() 
+    std::thread mthread{}; 
+
+    /** @brief The loop of the background thread, until stopped and drained */
+    void run() noexcept 
+    {
+        std::unique_lock<std::mutex> lock{ self.mmutex }; 
+        while ( true ) 
+        {
+            self.mready.wait( lock, [this]() { return self.mstop or not self.mqueue.empty(); } ); 
+            if ( self.mqueue.empty() ) 
+                return; 
+            const Snapshot snapshot{ std::move( self.mqueue.front() ) }; 
+            self.mqueue.pop_front(); 
+            lock.unlock(); 
+
+            std::exception_ptr error{}; 
+            try 
+            {
+                weights_write( snapshot.fname, snapshot.format, snapshot.header, snapshot.buffer->get() ); 
+            }
+            catch (...) 
+            { error = std::current_exception(); }
+
+            lock.lock(); 
+            if ( error and not self.merror ) 
+                self.merror = error; 
+            self.mfree.push_back( snapshot.buffer ); 
+            self.minflight--; 
+            self.mdone.notify_all(); 
+        }
+    }
+
+    /** @brief Rethrows (once) the first error of the background thread, if any; the lock must be held */
+    void rethrow() 
+    {
+        if ( not self.merror ) 
+            return; 
+        std::exception_ptr error{ self.merror }; 
+        self.merror = nullptr; 
+        std::rethrow_exception( error ); 
+    }
+
+    public: 
+    /** @brief SnapshotWriter in a disengaged state, see start() */
+    SnapshotWriter() {} 
+
+    SnapshotWriter(const SnapshotWriter&) = delete; 
+    SnapshotWriter& operator = (const SnapshotWriter&) = delete; 
+
+    /** @brief Writes the snapshots still in flight and stops the background thread */
+    ~SnapshotWriter() noexcept 
+    {
+        if ( not self.enabled() ) 
+            return; 
+        {
+            const std::lock_guard<std::mutex> lock{ self.mmutex }; 
+            self.mstop = true; 
+        }
+        self.mready.notify_all(); 
+        self.mthread.join(); 
+    }
+
+    /** @brief Starts the background thread, with at most capacity (> 0) snapshots in flight */
+    void start(unsigned capacity) 
+    {
+        assert( not self.enabled() ); 
+        assert( capacity > 0 ); 
+        self.mcapacity = capacity; 
+        self.mbuffers.reserve( capacity ); // the buffers never move 
+        self.mthread = std::thread{ &SnapshotWriter::run, this }; 
+    }
+
+    /** @brief Returns whether the background thread is running */
+    bool enabled() const noexcept { return self.mthread.joinable(); }
+
+    /** @brief Copies the Weights described by header, with values at values, and queues them 
+     *  to be written to fname in format, waiting if capacity snapshots are already in flight 
+     */
+    void write(const std::string& fname, PrintFormat format, const WeightsHeader& header, const T* values) 
+    {
+        assert( self.enabled() ); 
+        const std::size_t count{ static_cast<std::size_t>( header.rows ) *header.cols *header.dimensions }; 
+
+        som::Memory<T>* buffer; 
+        {
+            std::unique_lock<std::mutex> lock{ self.mmutex }; 
+            self.mdone.wait( lock, [this]() { return self.minflight < self.mcapacity; } ); 
+            self.rethrow(); 
+            if ( self.mfree.empty() ) 
+            {
+                const MemoryScope scope{ MemoryCategory::snapshots }; 
+                self.mbuffers.emplace_back( count ); 
+                self.mfree.push_back( &self.mbuffers.back() ); 
+            }
+            buffer = self.mfree.back(); 
+            self.mfree.pop_back(); 
+            self.minflight++; 
+        }
+        assert( buffer->size() == count ); 
+        std::copy( values, values + count, buffer->get() ); 
+
+        {
+            const std::lock_guard<std::mutex> lock{ self.mmutex }; 
+            self.mqueue.push_back( Snapshot{ fname, format, header, buffer } ); 
+        }
+        self.mready.notify_one(); 
+    }
+
+    /** @brief Waits for all the snapshots in flight to be written */
+    void flush() 
+    {
+        if ( not self.enabled() ) 
+            return; 
+        std::unique_lock<std::mutex> lock{ self.mmutex }; 
+        self.mdone.wait( lock, [this]() { return self.minflight == 0; } ); 
+        self.rethrow(); 
+    }
+}; // class SnapshotWriter
+} // namespace som
+#undef self
+#endif // SOM_WRITER_HPP_GUARD
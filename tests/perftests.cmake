@@ -0,0 +1,114 @@
+# DIAPASOM - DIstributed And PArallel Self Organizing Maps 
+# 
+# Copyright (c) 2022, eXact lab (<https://www.exact-lab.it>) All Rights Reserved.
+# You may use, distribute and modify this code under the
+# terms of the BSD 4-clause license. 
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT 
+#  ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or       
+# FITNESS FOR A PARTICULAR PURPOSE. 
+#
+# You should have received a copy of the BSD 4-clause license along 
+# with DIAPASOM; see the file LICENSE. If not see 
+# <https://en.wikipedia.org/wiki/BSD_licenses>.
+#
+#
+# Authors: 
+#     Matteo Barnaba <matteo.barnaba@exact-lab.it>
+#     Matteo Poggi <matteo.poggi@exact-lab.it>
+#     Giuseppe Piero Brandino <giuseppe.brandino@exact-lab.it>
+#
+
+
+# Performance regression tests: fixed-size synthetic workloads, generated once by diapasom-generate, 
+# whose best records per second is checked by tests/perfcheck against the per-machine baseline file 
+# "perfbaseline", failing if slower by more than "perfthreshold" and skipped if there is no baseline. 
+# The baselines are recorded (or refreshed) by running the tests with DIAPASOM_PERF_REFRESH=1, e.g.: 
+#   DIAPASOM_PERF_REFRESH=1 ctest -L perf 
+# variables "testsOutFolderBase", "implementation", "perfbaseline" and "perfthreshold" 
+# are set by the main cmake file that will include this file
+
+
+# name, generator parameters and training parameters of each workload 
+set( perfworkloads 
+    "dense16|dimensions=16|latticedim=20 batchsize=1000"
+    "dense64|dimensions=64|latticedim=20 batchsize=1000"
+    "sparse256|dimensions=256 density=0.05 format=svmlight|latticedim=20 batchsize=1000 storage=sparse"
+)
+set( perfrecords 20000 )
+set( perfepochs 3 )
+set( perfdatafolder "${testsOutFolderBase}/perfdata" )
+
+# the baselines depend on the build type too 
+set( perfbuild "${CMAKE_BUILD_TYPE}" )
+if ( "${perfbuild}" STREQUAL "" )
+    set( perfbuild "None" )
+endif()
+
+
+foreach( workload IN ITEMS ${perfworkloads} )
+    string( REPLACE "|" ";" workload "${workload}" )
+    list( GET workload 0 name )
+    list( GET workload 1 generation )
+    list( GET workload 2 training )
+    set( datafile "${perfdatafolder}/${name}.txt" )
+
+    # the datasets are shared by all implementations 
+    set( testname "perfGenerate${name}" )
+    if ( NOT TEST ${testname} )
+        file( MAKE_DIRECTORY "${perfdatafolder}" )
+        set( cmd "${CMAKE_BINARY_DIR}/diapasom-generate records=${perfrecords} ${generation} rseed=1 output=${datafile}" )
+        message( STATUS "${testname}: ${cmd}" ) 
+        add_test(
+            NAME ${testname}
+            COMMAND sh -c "${cmd}"
+        )
+        set_tests_properties(
+            ${testname}
+            PROPERTIES 
+            FIXTURES_SETUP "perf${name}"
+            LABELS "perf"
+        )
+    endif()
+
+    set( testname "${implementation}Perf_${name}" )
+    set( outfolder "${testsOutFolderBase}/${testname}" )
+    file( MAKE_DIRECTORY "${outfolder}" )
+
+    set( executable "${CMAKE_BINARY_DIR}/diapasom.${implementation}" )
+    set( cmd "${executable}" )
+
+    if ( "${implementation}" STREQUAL "mpi" )
+        set( cmd "${mpiFolder}/bin/mpirun -np 3 ${cmd}" )
+    endif()
+
+    if ( "${implementation}" STREQUAL "oshmem" )
+        set( cmd "${oshmemFolder}/bin/shmemrun -quiet -np 3 ${cmd}" )
+    endif()
+
+    string( 
+        CONCAT cmd 
+        "cd ${outfolder} && "
+        "${CMAKE_SOURCE_DIR}/tests/perfcheck "
+        "${perfbaseline} ${testname}.${perfbuild} ${perfthreshold} "
+        "${cmd} "
+        "dataset=${datafile} "
+        "epochs=${perfepochs} "
+        "rseed=1 "
+        "${training} "
+    ) 
+
+    message( STATUS "${testname}: ${cmd}" ) 
+    add_test(
+        NAME ${testname}
+        COMMAND sh -c "${cmd}"
+    )  
+    set_tests_properties(
+        ${testname}
+        PROPERTIES 
+        FIXTURES_REQUIRED "perf${name}"
+        SKIP_RETURN_CODE 77
+        RUN_SERIAL true
+        LABELS "perf"
+    )
+endforeach()
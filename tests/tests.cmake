@@ -104,3 +104,300 @@ foreach( dataset IN ITEMS 1 2 )
         endforeach()
     endforeach()
 endforeach()
+
+
+# training options: the training is run on dataset 2 and the initial state (epoch 0) 
+# is checked against the reference one, the final state (printed as epoch 21) 
+# is checked against the reference epoch 20 only for the options in exactoptions, 
+# that shall reproduce the reference outputs digit by digit, and for the ones in 
+# tolerances (option, relative tolerance pairs), that shall reproduce them within 
+# the tolerance (see tests/numdiff); the quantized storages do not reproduce 
+# the records exactly, their initial state is checked within the tolerance too. 
+# The options in ownreferences do not train the same lattice as the default ones, 
+# they are checked against their own references, with the option name appended 
+# to the dataset one (e.g. metric=cosine scales the records to unit norm), the initial 
+# state against the default one if it does not depend on the option (e.g. the other metrics); the 
+# binary storage is trained on dataset 3, a 0/1 dataset. The approximate BMU searches 
+# in mismatchrates (option, largest rate pairs) are also checked on the mismatch rate 
+# (BMUs that differ from the exact ones) they report for the last epoch. The options in 
+# binaryoutputs print the Lattice in binary format, read back by tests/bincheck (header 
+# fields, payload size and values within the tolerance of the text references) 
+set( dataset 2 ) 
+set( dimensions 2 ) # of dataset 2 
+set( rseed 123 )
+set( batchsize 100 )
+set( exactoptions 
+    "storage=sparse" "bmusearch=bounds" "bmusearch=tree" "layout=interleaved8" "layout=interleaved16" 
+    "printmode=async" "storage=binary" "metric=cosine" "metric=manhattan" "metric=mahalanobis" 
+    "alignment=4096" "hugepages=advise" "numa=firsttouch" 
+)
+set( tolerances 
+    "precision=single" 1e-5 
+    "precision=mixed" 1e-5 
+    "storage=uint8" 2e-3 
+    "storage=uint16" 1e-4 
+    "printformat=binary" 1e-5 
+)
+set( quantizedoptions "storage=uint8" "storage=uint16" )
+set( ownreferences "storage=binary" "metric=cosine" "metric=manhattan" "metric=mahalanobis" )
+set( binaryoutputs "printformat=binary" )
+set( mismatchrates 
+    "bmusearch=window" 0.2 
+)
+
+foreach( option IN ITEMS 
+    "precision=single" "precision=mixed" "storage=uint8" "storage=uint16" "storage=sparse" 
+    "storage=binary" "metric=cosine" "metric=manhattan" "metric=mahalanobis" 
+    "bmusearch=bounds" "bmusearch=window" "bmusearch=tree" "bmusearch=projection" 
+    "layout=interleaved8" "layout=interleaved16" "printmode=async" 
+    "alignment=4096" "hugepages=advise" "numa=firsttouch" "printformat=binary" 
+)
+    string( REPLACE "=" "_" optname "${option}" )
+
+    set( optdataset ${dataset} )
+    if ( "${option}" STREQUAL "storage=binary" ) 
+        set( optdataset 3 )
+    endif()
+
+    if ( "${option}" STREQUAL "storage=sparse" ) # same records, svmlight format 
+        set( datafile "${CMAKE_SOURCE_DIR}/tests/dataset${optdataset}.svm" )
+    else()
+        set( datafile "${CMAKE_SOURCE_DIR}/tests/dataset${optdataset}.txt" )
+    endif()
+
+    list( FIND ownreferences "${option}" own )
+    if ( own GREATER -1 ) 
+        set( refsuffix "_${optname}" )
+    else()
+        set( refsuffix "" )
+    endif()
+
+    set( testname "${implementation}DS${optdataset}RS${rseed}BS${batchsize}_${optname}" )
+    set( outfolder "${testsOutFolderBase}/${testname}" )
+    file( MAKE_DIRECTORY "${outfolder}" )
+
+    set( executable "${CMAKE_BINARY_DIR}/diapasom.${implementation}" )
+    set( cmd "${CMAKE_SOURCE_DIR}/tests/wrapper ${executable}" )
+
+    if ( "${implementation}" STREQUAL "mpi" )
+        set( cmd "${mpiFolder}/bin/mpirun -np 3 ${cmd}" )
+    endif()
+
+    if ( "${implementation}" STREQUAL "oshmem" )
+        set( cmd "${oshmemFolder}/bin/shmemrun -quiet -np 3 ${cmd}" )
+    endif()
+
+    string( 
+        CONCAT cmd 
+        "cd ${outfolder} && "
+        "${cmd} "
+        "dataset=${datafile} "
+        "latticedim=${latticedim} "
+        "batchsize=${batchsize} "
+        "epochs=${epochs} "
+        "rseed=${rseed} "
+        "${option} "
+    ) 
+
+    message( STATUS "${testname}: ${cmd}" ) 
+    add_test(
+        NAME ${testname}
+        COMMAND sh -c "${cmd}"
+    )  
+
+    list( FIND tolerances "${option}" index )
+    if ( index GREATER -1 ) 
+        math( EXPR index "${index} + 1" )
+        list( GET tolerances ${index} tolerance )
+    else()
+        set( tolerance "" )
+    endif()
+
+    set( reference "${CMAKE_SOURCE_DIR}/tests/reference/dataset${optdataset}${refsuffix}lattice0.out" )
+    if ( NOT EXISTS "${reference}" ) 
+        set( reference "${CMAKE_SOURCE_DIR}/tests/reference/dataset${optdataset}lattice0.out" )
+    endif()
+    list( FIND quantizedoptions "${option}" quantized )
+    list( FIND binaryoutputs "${option}" binaryoutput )
+    if ( binaryoutput GREATER -1 ) 
+        set( cmd "${CMAKE_SOURCE_DIR}/tests/bincheck ${outfolder}/lattice0.bin ${latticedim} ${latticedim} ${dimensions} 8 0 ${reference} ${tolerance}" )
+    elseif ( quantized GREATER -1 ) 
+        set( cmd "${CMAKE_SOURCE_DIR}/tests/numdiff ${tolerance} ${outfolder}/lattice0.out ${reference}" )
+    else()
+        set( cmd "diff ${outfolder}/lattice0.out ${reference}" )
+    endif()
+    message( STATUS "${testname}EP0: ${cmd}" ) 
+    add_test( 
+        NAME ${testname}EP0
+        COMMAND sh -c "${cmd}"
+    )
+
+    set( reference "${CMAKE_SOURCE_DIR}/tests/reference/dataset${optdataset}RS${rseed}BS${batchsize}${refsuffix}lattice20.out" )
+    list( FIND exactoptions "${option}" exact )
+    if ( exact GREATER -1 ) 
+        set( cmd "diff ${outfolder}/lattice21.out ${reference}" )
+    elseif ( binaryoutput GREATER -1 ) 
+        set( cmd "${CMAKE_SOURCE_DIR}/tests/bincheck ${outfolder}/lattice21.bin ${latticedim} ${latticedim} ${dimensions} 8 21 ${reference} ${tolerance}" )
+    elseif ( tolerance ) 
+        set( cmd "${CMAKE_SOURCE_DIR}/tests/numdiff ${tolerance} ${outfolder}/lattice21.out ${reference}" )
+    else()
+        set( cmd "" )
+    endif()
+
+    if ( cmd ) 
+        message( STATUS "${testname}EP20: ${cmd}" ) 
+        add_test( 
+            NAME ${testname}EP20
+            COMMAND sh -c "${cmd}"
+        )
+    endif()
+
+    list( FIND mismatchrates "${option}" index )
+    if ( index GREATER -1 ) 
+        math( EXPR index "${index} + 1" )
+        list( GET mismatchrates ${index} rate )
+        set( cmd "cat ${outfolder}/rank*.out | awk '/mismatch rate/ { rate = $NF } END { print \"mismatch rate\", rate; exit (rate != \"\" && rate <= ${rate})? 0 : 1 }'" )
+        message( STATUS "${testname}Mismatch: ${cmd}" ) 
+        add_test( 
+            NAME ${testname}Mismatch
+            COMMAND sh -c "${cmd}"
+        )
+    endif()
+endforeach()
+
+
+# high-dimensional datasets: dataset 4 has 20 dimensions and dataset 5 has 32 (made with 
+# diapasom-generate records=400 dimensions=20 or 32 clusters=6 rseed=4 or 5), more than the 
+# abandon_block ones summed between two checks of the early-abandoned distances, so the exact 
+# BMU searches and layouts in hexactoptions actually abandon them and shall still reproduce the 
+# reference outputs (of the default search) digit by digit. The default search runs the generic 
+# kernels on dataset 4 and the ones specialized for 32 dimensions on dataset 5 (see batch_kernels()). 
+# The approximate BMU searches in hmismatchrates (option, largest rate pairs) run on dataset 4 only, 
+# checked on the mismatch rate they report for the last epoch: the random projection keeps 
+# bmusketch=8 of the 20 dimensions, so the rate measures its shortlist 
+set( hexactoptions 
+    "default" "bmusearch=scan" "bmusearch=bounds" "bmusearch=tree" "layout=interleaved8" "layout=interleaved16" 
+)
+set( hmismatchrates 
+    "bmusearch=projection bmusketch=8" 0.05 
+)
+
+foreach( hdataset IN ITEMS 4 5 )
+    set( hoptions ${hexactoptions} )
+    if ( "${hdataset}" EQUAL 4 ) 
+        list( LENGTH hmismatchrates count )
+        math( EXPR last "${count} - 1" )
+        foreach( index RANGE 0 ${last} 2 )
+            list( GET hmismatchrates ${index} option )
+            list( APPEND hoptions "${option}" )
+        endforeach()
+    endif()
+
+    foreach( option IN LISTS hoptions )
+        string( REGEX REPLACE "[= ]" "_" optname "${option}" )
+
+        set( testname "${implementation}DS${hdataset}RS${rseed}BS${batchsize}_${optname}" )
+        set( outfolder "${testsOutFolderBase}/${testname}" )
+        file( MAKE_DIRECTORY "${outfolder}" )
+
+        set( executable "${CMAKE_BINARY_DIR}/diapasom.${implementation}" )
+        set( cmd "${CMAKE_SOURCE_DIR}/tests/wrapper ${executable}" )
+
+        if ( "${implementation}" STREQUAL "mpi" )
+            set( cmd "${mpiFolder}/bin/mpirun -np 3 ${cmd}" )
+        endif()
+
+        if ( "${implementation}" STREQUAL "oshmem" )
+            set( cmd "${oshmemFolder}/bin/shmemrun -quiet -np 3 ${cmd}" )
+        endif()
+
+        set( optargs "${option}" )
+        if ( "${option}" STREQUAL "default" ) 
+            set( optargs "" )
+        endif()
+
+        string( 
+            CONCAT cmd 
+            "cd ${outfolder} && "
+            "${cmd} "
+            "dataset=${CMAKE_SOURCE_DIR}/tests/dataset${hdataset}.txt "
+            "latticedim=${latticedim} "
+            "batchsize=${batchsize} "
+            "epochs=${epochs} "
+            "rseed=${rseed} "
+            "${optargs} "
+        ) 
+
+        message( STATUS "${testname}: ${cmd}" ) 
+        add_test(
+            NAME ${testname}
+            COMMAND sh -c "${cmd}"
+        )  
+
+        set( cmd "diff ${outfolder}/lattice0.out ${CMAKE_SOURCE_DIR}/tests/reference/dataset${hdataset}lattice0.out" )
+        message( STATUS "${testname}EP0: ${cmd}" ) 
+        add_test( 
+            NAME ${testname}EP0
+            COMMAND sh -c "${cmd}"
+        )
+
+        list( FIND hexactoptions "${option}" exact )
+        if ( exact GREATER -1 ) 
+            set( cmd "diff ${outfolder}/lattice21.out ${CMAKE_SOURCE_DIR}/tests/reference/dataset${hdataset}RS${rseed}BS${batchsize}lattice20.out" )
+            message( STATUS "${testname}EP20: ${cmd}" ) 
+            add_test( 
+                NAME ${testname}EP20
+                COMMAND sh -c "${cmd}"
+            )
+        endif()
+
+        list( FIND hmismatchrates "${option}" index )
+        if ( index GREATER -1 ) 
+            math( EXPR index "${index} + 1" )
+            list( GET hmismatchrates ${index} rate )
+            set( cmd "cat ${outfolder}/rank*.out | awk '/mismatch rate/ { rate = $NF } END { print \"mismatch rate\", rate; exit (rate != \"\" && rate <= ${rate})? 0 : 1 }'" )
+            message( STATUS "${testname}Mismatch: ${cmd}" ) 
+            add_test( 
+                NAME ${testname}Mismatch
+                COMMAND sh -c "${cmd}"
+            )
+        endif()
+    endforeach()
+endforeach()
+
+
+# failing writes: the first snapshot written in the background (printmode=async) goes to 
+# /dev/full, the training shall fail with the error of the background thread 
+set( testname "${implementation}DS${dataset}RS${rseed}BS${batchsize}_printmode_async_full" )
+set( outfolder "${testsOutFolderBase}/${testname}" )
+file( MAKE_DIRECTORY "${outfolder}" )
+
+set( cmd "${CMAKE_BINARY_DIR}/diapasom.${implementation}" )
+
+if ( "${implementation}" STREQUAL "mpi" )
+    set( cmd "${mpiFolder}/bin/mpirun -np 3 ${cmd}" )
+endif()
+
+if ( "${implementation}" STREQUAL "oshmem" )
+    set( cmd "${oshmemFolder}/bin/shmemrun -quiet -np 3 ${cmd}" )
+endif()
+
+string( 
+    CONCAT cmd 
+    "cd ${outfolder} && ln -sf /dev/full lattice0.out && "
+    "! ${cmd} "
+    "dataset=${CMAKE_SOURCE_DIR}/tests/dataset${dataset}.txt "
+    "latticedim=${latticedim} "
+    "batchsize=${batchsize} "
+    "epochs=${epochs} "
+    "rseed=${rseed} "
+    "printmode=async "
+    "1>rank.out 2>rank.err && "
+    "grep 'could not write lattice0.out' rank.err"
+) 
+
+message( STATUS "${testname}: ${cmd}" ) 
+add_test(
+    NAME ${testname}
+    COMMAND sh -c "${cmd}"
+)  